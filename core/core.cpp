@@ -1,4 +1,5 @@
 #include "core.hpp"
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -13,12 +14,13 @@
 #define BLUE "\033[34m"
 #define RESET "\033[0m"
 
-Core::Core(int bits) 
-    : bits(bits), state(DISCONNECTED), running(false), keyExchangeComplete(false) {
-    encryptor = make_unique<MessageEncryptor>(bits);
+Core::Core(int bits, MessageEncryptor::CipherMode cipherMode, bool encryptThenMac, const NamedGroup* group) 
+    : bits(group ? group->bits : bits), cipherMode(cipherMode), encryptThenMac(encryptThenMac), wireEncoding(MessageEncryptor::HEX), group(group), state(DISCONNECTED), running(false), sendEpoch(0), sentMessages(0), sentBytes(0), receiveEpoch(0), keyExchangeComplete(false) {
+    encryptor = make_unique<MessageEncryptor>(this->bits, cipherMode, encryptThenMac, group);
     sessionId = generateSessionId();
     updateLastActivity();
-    log("Core initialized with " + to_string(bits) + " bits");
+    log("Core initialized with " + to_string(this->bits) + " bits, SM4-" + cipherModeName(cipherMode)
+        + (group ? string(", group ") + group->name : string()));
 }
 
 Core::~Core() {
@@ -76,7 +78,17 @@ bool Core::startClient(const string& host, int port) {
 
     // 测试连接
     auto result = client->Get("/status");
-    auto response = json::parse(result->body);
+    if (!result || result->status != 200) {
+        log("Failed to connect to server", ERROR);
+        setState(DISCONNECTED);
+        return false;
+    }
+    auto response = json::parse(result->body, nullptr, false);
+    if (response.is_discarded() || !response.is_object() || !response.contains("bits") || !response["bits"].is_number_integer()) {
+        log("Invalid status response from server", ERROR);
+        setState(DISCONNECTED);
+        return false;
+    }
     auto bits_ = response["bits"].get<int>();
 
     if (bits_ != bits) {
@@ -84,12 +96,39 @@ bool Core::startClient(const string& host, int port) {
         setState(DISCONNECTED);
         return false;
     }
-    
-    if (!result || result->status != 200) {
-        log("Failed to connect to server", ERROR);
+
+    auto cipher_ = response.value("cipher", string());
+    if (cipher_ != cipherModeName(cipherMode)) {
+        log("Server cipher mismatch: expected " + cipherModeName(cipherMode) + ", got " + (cipher_.empty() ? "none" : cipher_), ERROR);
         setState(DISCONNECTED);
         return false;
     }
+
+    // 旧版本服务端不返回kdf字段，派生的SM4密钥与本端不同，握手后所有消息都无法解密
+    auto kdf_ = response.value("kdf", string());
+    if (kdf_ != MessageEncryptor::KDF_NAME) {
+        log("Server key derivation mismatch: expected " + string(MessageEncryptor::KDF_NAME) + ", got " + (kdf_.empty() ? "legacy" : kdf_), ERROR);
+        setState(DISCONNECTED);
+        return false;
+    }
+
+    auto mac_ = response.value("mac", false);
+    if (mac_ != encryptThenMac) {
+        log(string("Server MAC mismatch: expected ") + (encryptThenMac ? "on" : "off") + ", got " + (mac_ ? "on" : "off"), ERROR);
+        setState(DISCONNECTED);
+        return false;
+    }
+
+    // 服务端提供base64时使用base64，否则HEX；选定的编码在公钥消息中告知服务端
+    auto encodings_ = response.value("encodings", json::array());
+    bool base64_ = find(encodings_.begin(), encodings_.end(), wireEncodingName(MessageEncryptor::BASE64)) != encodings_.end();
+    setWireEncoding(base64_ ? MessageEncryptor::BASE64 : MessageEncryptor::HEX);
+
+    // 双方各自用自己的群生成公钥，群不同也能完成握手，这里只记录
+    auto group_ = response.value("group", json(nullptr));
+    if (group_.is_string()) {
+        log("Server uses named group " + group_.get<string>());
+    }
     
     setState(CONNECTED);
     
@@ -147,6 +186,11 @@ void Core::handleStatus(const httplib::Request& req, httplib::Response& res) {
     response["state"] = static_cast<int>(state);
     response["session_id"] = sessionId;
     response["bits"] = bits;
+    response["cipher"] = cipherModeName(cipherMode);
+    response["mac"] = encryptThenMac;
+    response["kdf"] = MessageEncryptor::KDF_NAME;
+    response["encodings"] = {wireEncodingName(MessageEncryptor::HEX), wireEncodingName(MessageEncryptor::BASE64)};
+    response["group"] = group ? json(group->name) : json(nullptr); // null表示每次握手生成新的安全素数
     sendJsonResponse(res, response);
 }
 
@@ -156,16 +200,53 @@ void Core::handleKeyExchange(const httplib::Request& req, httplib::Response& res
         string type = requestData["type"];
         
         if (type == "public_key") {
+            // 旧版本客户端不带kdf字段，密钥派生方式不同，拒绝握手
+            if (requestData.value("kdf", string()) != MessageEncryptor::KDF_NAME) {
+                log("Client key derivation mismatch", WARNING);
+                sendJsonResponse(res, {{"error", "Unsupported key derivation"}}, 400);
+                return;
+            }
+            // 未指定encoding时使用HEX
+            bool base64_ = requestData.value("encoding", wireEncodingName(MessageEncryptor::HEX)) == wireEncodingName(MessageEncryptor::BASE64);
+            setWireEncoding(base64_ ? MessageEncryptor::BASE64 : MessageEncryptor::HEX);
             if (receivePublicKey(requestData["data"])) {
                 // 发送自己的公钥作为响应
+                // 客户端断开或服务关闭时取消素数搜索，不再为无人接收的响应占用CPU
+                PrimeSearchCancel cancel;
+                atomic<bool> keygenDone(false);
+                thread watcher([&] {
+                    while (!keygenDone) {
+                        if (req.is_connection_closed() || !running) {
+                            cancel.cancel();
+                            break;
+                        }
+                        this_thread::sleep_for(chrono::milliseconds(100));
+                    }
+                });
+                
                 mpz_t p, g, y;
                 mpz_inits(p, g, y, NULL);
-                encryptor->SendPKG(p, g, y);
+                bool generated = encryptor->SendPKG(p, g, y, &cancel, KEYGEN_TIMEOUT);
+                keygenDone = true;
+                watcher.join();
+                if (!generated) {
+                    if (cancel.isCancelled()) {
+                        // 对方已断开或本端正在关闭，响应多半无人接收
+                        log("Key generation cancelled: client disconnected or server stopping", WARNING);
+                        sendJsonResponse(res, {{"error", "Key generation cancelled"}}, 503);
+                    } else {
+                        log("Key generation timed out", WARNING);
+                        sendJsonResponse(res, {{"error", "Key generation timed out"}}, 503);
+                    }
+                    mpz_clears(p, g, y, NULL);
+                    return;
+                }
                 
                 json responseData;
                 responseData["p"] = mpz_get_str(nullptr, 10, p);
                 responseData["g"] = mpz_get_str(nullptr, 10, g);
                 responseData["y"] = mpz_get_str(nullptr, 10, y);
+                addPrimeCertificate(responseData);
                 
                 json response = createMessage("public_key", responseData);
                 sendJsonResponse(res, response);
@@ -210,10 +291,10 @@ void Core::handleSendMessage(const httplib::Request& req, httplib::Response& res
     
     try {
         auto requestData = json::parse(req.body);
-        string encryptedMessage = requestData["encrypted_message"];
         
+        // GCM模式下标签错误会直接抛出异常，篡改的明文不会进入日志和队列
         string decryptedMessage;
-        encryptor->DecryptMessage(encryptedMessage, decryptedMessage);
+        decryptMessage(requestData, decryptedMessage);
         
         log("Received encrypted message, decrypted: " + decryptedMessage);
         
@@ -277,14 +358,21 @@ bool Core::sendPublicKey() {
     mpz_t p, g, y;
     mpz_inits(p, g, y, NULL);
     
-    encryptor->SendPKG(p, g, y);
+    if (!encryptor->SendPKG(p, g, y)) {
+        log("Key generation failed", WARNING);
+        mpz_clears(p, g, y, NULL);
+        return false;
+    }
     
     json data;
     data["p"] = mpz_get_str(nullptr, 10, p);
     data["g"] = mpz_get_str(nullptr, 10, g);
     data["y"] = mpz_get_str(nullptr, 10, y);
+    addPrimeCertificate(data);
     
     json message = createMessage("public_key", data);
+    message["encoding"] = wireEncodingName(wireEncoding);
+    message["kdf"] = MessageEncryptor::KDF_NAME;
     
     auto result = client->Post("/api/key_exchange", message.dump(), "application/json");
     
@@ -316,6 +404,18 @@ bool Core::receivePublicKey(const json& data) {
         mpz_set_str(g, data["g"].get<string>().c_str(), 10);
         mpz_set_str(y, data["y"].get<string>().c_str(), 10);
         
+        // 验证p为安全素数、g属于q阶子群
+        if (!data.contains("cert")) {
+            log("Public key has no prime certificate", WARNING);
+            mpz_clears(p, g, y, NULL);
+            return false;
+        }
+        if (!verifyPrimeCertificate(data["cert"], p, g)) {
+            log("Invalid prime certificate in public key", WARNING);
+            mpz_clears(p, g, y, NULL);
+            return false;
+        }
+        
         encryptor->ReceivePKG(p, g, y);
         
         string pStr = data["p"].get<string>();
@@ -330,6 +430,42 @@ bool Core::receivePublicKey(const json& data) {
     }
 }
 
+// 证书: q = (p - 1) / 2 和Pocklington见证a，对方对q做一次BailliePSW、对p做一次模幂即可确认p为素数
+void Core::addPrimeCertificate(json& data) {
+    mpz_t q;
+    mpz_init(q);
+    unsigned long witness = 0;
+    encryptor->GetPrimeCertificate(q, witness);
+    if (witness != 0) {
+        data["cert"] = {{"q", mpz_get_str(nullptr, 10, q)}, {"a", witness}};
+    }
+    mpz_clear(q);
+}
+
+bool Core::verifyPrimeCertificate(const json& cert, mpz_t p, mpz_t g) {
+    // 格式错误的证书直接拒绝，不抛出异常
+    if (!cert.is_object() || !cert.contains("q") || !cert["q"].is_string()
+        || !cert.contains("a") || !cert["a"].is_number_unsigned()) {
+        return false;
+    }
+    // p的位数必须与/status中协商的一致
+    if (mpz_sizeinbase(p, 2) != (size_t)bits) {
+        return false;
+    }
+    
+    mpz_t q, t;
+    mpz_inits(q, t, NULL);
+    bool ok = mpz_set_str(q, cert["q"].get<string>().c_str(), 10) == 0
+              && verifySafePrime(p, q, cert["a"].get<unsigned long>());
+    if (ok) {
+        // 1 < g < p 且 g^q ≡ 1 (mod p)
+        mpz_powm(t, g, q, p);
+        ok = mpz_cmp_ui(g, 1) > 0 && mpz_cmp(g, p) < 0 && mpz_cmp_ui(t, 1) == 0;
+    }
+    mpz_clears(q, t, NULL);
+    return ok;
+}
+
 bool Core::sendSecret() {
     mpz_t c1, c2;
     mpz_inits(c1, c2, NULL);
@@ -388,6 +524,15 @@ void Core::completeKeyExchange() {
         lock_guard<mutex> lock(keyExchangeMutex);
         keyExchangeComplete = true;
     }
+    // 新的会话密钥从epoch 0开始
+    {
+        lock_guard<mutex> lock(messageMutex);
+        sendEpoch = sentMessages = sentBytes = 0;
+    }
+    {
+        lock_guard<mutex> lock(receiveMutex);
+        receiveEpoch = 0;
+    }
     
     string key1, key2;
     encryptor->GetSM4Key(key1, key2);
@@ -422,29 +567,48 @@ void Core::processMessageQueue() {
         if (!running) break;
         
         while (!outgoingMessageQueue.empty()) {
-            string message = outgoingMessageQueue.front();
-            outgoingMessageQueue.pop();
+            // 每次取出一批消息一起加密(CBC模式下交错送入多分组内核)
+            vector<string> batch;
+            while (!outgoingMessageQueue.empty() && batch.size() < SM4_CBC_MAX_LANES) {
+                batch.push_back(std::move(outgoingMessageQueue.front()));
+                outgoingMessageQueue.pop();
+            }
+            // 同一组密钥加密的消息数或明文字节数达到上限时换钥，这一批起使用新的epoch
+            if (sentMessages >= REKEY_MESSAGES || sentBytes >= REKEY_BYTES) {
+                encryptor->RekeySM4(0);
+                sendEpoch++;
+                sentMessages = sentBytes = 0;
+                log("Rekeyed outgoing messages, epoch " + to_string(sendEpoch));
+            }
+            sentMessages += batch.size();
+            for (const auto& message : batch) {
+                sentBytes += message.size();
+            }
+            uint64_t epoch = sendEpoch;
             lock.unlock();
             
-            // 加密消息
-            string encryptedMessage;
-            encryptor->EncryptMessage(message, encryptedMessage);
+            vector<string> encryptedBatch;
+            encryptor->EncryptMessages(batch, encryptedBatch);
             
-            if (mode == SERVER) {
-                // 服务器模式：将消息存储到队列中等待客户端轮询
-                lock_guard<mutex> serverLock(serverMessageMutex);
-                serverToClientMessages.push(encryptedMessage);
-                log("Stored encrypted message for client: " + message);
-            } else {
-                // 客户端模式：直接发送到服务器
+            for (size_t i = 0; i < batch.size(); i++) {
+                const string& message = batch[i];
                 json requestData;
-                requestData["encrypted_message"] = encryptedMessage;
+                requestData["encrypted_message"] = encryptedBatch[i];
+                requestData["epoch"] = epoch;
                 
-                auto result = client->Post("/api/send_message", requestData.dump(), "application/json");
-                if (result && result->status == 200) {
-                    log("Sent encrypted message: " + message);
+                if (mode == SERVER) {
+                    // 服务器模式：将消息存储到队列中等待客户端轮询
+                    lock_guard<mutex> serverLock(serverMessageMutex);
+                    serverToClientMessages.push(std::move(requestData));
+                    log("Stored encrypted message for client: " + message);
                 } else {
-                    log("Failed to send message: " + message, WARNING);
+                    // 客户端模式：直接发送到服务器
+                    auto result = client->Post("/api/send_message", requestData.dump(), "application/json");
+                    if (result && result->status == 200) {
+                        log("Sent encrypted message: " + message);
+                    } else {
+                        log("Failed to send message: " + message, WARNING);
+                    }
                 }
             }
             
@@ -463,8 +627,14 @@ void Core::pollMessages() {
                     auto messages = response["messages"];
                     
                     for (const auto& encryptedMessage : messages) {
+                        // 单条消息认证失败只丢弃该条
                         string decryptedMessage;
-                        encryptor->DecryptMessage(encryptedMessage.get<string>(), decryptedMessage);
+                        try {
+                            decryptMessage(encryptedMessage, decryptedMessage);
+                        } catch (const exception& e) {
+                            log("Dropped message: " + string(e.what()), WARNING);
+                            continue;
+                        }
                         
                         log("Received encrypted message, decrypted: " + decryptedMessage);
                         
@@ -482,6 +652,21 @@ void Core::pollMessages() {
     }
 }
 
+// 两个方向的消息各自按序到达: 对方换钥后的第一条消息带上下一个epoch，本端随之换钥；
+// 更旧的epoch或一次跳过多个epoch的消息无法解密
+void Core::decryptMessage(const json& message, string& plain) {
+    uint64_t epoch = message.at("epoch").get<uint64_t>();
+    lock_guard<mutex> lock(receiveMutex);
+    if (epoch == receiveEpoch + 1) {
+        encryptor->RekeySM4(1);
+        receiveEpoch = epoch;
+        log("Rekeyed incoming messages, epoch " + to_string(receiveEpoch));
+    } else if (epoch != receiveEpoch) {
+        throw runtime_error("message key epoch " + to_string(epoch) + " does not match " + to_string(receiveEpoch));
+    }
+    encryptor->DecryptMessage(message.at("encrypted_message").get<string>(), plain);
+}
+
 json Core::createMessage(const string& type, const json& data) {
     json message;
     message["type"] = type;
@@ -576,6 +761,24 @@ string Core::generateSessionId() {
     return sessionId;
 }
 
+string Core::cipherModeName(MessageEncryptor::CipherMode mode) {
+    switch (mode) {
+        case MessageEncryptor::CTR: return "ctr";
+        case MessageEncryptor::GCM: return "gcm";
+        default: return "cbc";
+    }
+}
+
+string Core::wireEncodingName(MessageEncryptor::WireEncoding encoding) {
+    return encoding == MessageEncryptor::BASE64 ? "base64" : "hex";
+}
+
+void Core::setWireEncoding(MessageEncryptor::WireEncoding encoding) {
+    wireEncoding = encoding;
+    encryptor->SetWireEncoding(encoding);
+    log("Wire encoding: " + wireEncodingName(encoding));
+}
+
 void Core::updateLastActivity() {
     lastActivity = chrono::steady_clock::now();
 }
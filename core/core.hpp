@@ -40,7 +40,9 @@ public:
         ERROR
     };
 
-    Core(int bits = 256);
+    /// @param group 标准安全素数群，非空时bits取群的位数，握手时不再生成素数
+    Core(int bits = 256, MessageEncryptor::CipherMode cipherMode = MessageEncryptor::CBC, bool encryptThenMac = false,
+         const NamedGroup* group = nullptr);
     ~Core();
 
     bool startServer(const string& host = "localhost", int port = 8848);
@@ -56,10 +58,18 @@ public:
     void waitForConnection();
 
 private:
+    static constexpr chrono::milliseconds KEYGEN_TIMEOUT{120000}; // 响应对方公钥时生成密钥的最长时间
+    static constexpr uint64_t REKEY_MESSAGES = 1u << 20; // 同一组SM4密钥最多加密的消息数，达到后换钥
+    static constexpr uint64_t REKEY_BYTES = 1ull << 30;  // 同一组SM4密钥最多加密的明文字节数
+    
     // 状态
     Mode mode;
     ConnectionState state;
     int bits;
+    MessageEncryptor::CipherMode cipherMode;
+    bool encryptThenMac; // CBC模式附加HMAC-SM3
+    MessageEncryptor::WireEncoding wireEncoding; // 密文在JSON中的编码，密钥交换时确定
+    const NamedGroup* group; // 自己的公钥所用的标准群，对方的群不必相同
     unique_ptr<MessageEncryptor> encryptor;
     
     // 通信
@@ -83,9 +93,16 @@ private:
     mutex messageMutex;
     condition_variable messageCondition;
     
-    queue<string> serverToClientMessages;
+    queue<json> serverToClientMessages; // {"encrypted_message", "epoch"}，等待客户端轮询
     mutex serverMessageMutex;
     
+    // 换钥: 发送方按消息数/字节数换钥并在每条消息中附上epoch，接收方见到下一个epoch时随之换钥
+    uint64_t sendEpoch;      // 以下三项由messageMutex保护
+    uint64_t sentMessages;   // 当前epoch已加密的消息数
+    uint64_t sentBytes;      // 当前epoch已加密的明文字节数
+    uint64_t receiveEpoch;
+    mutex receiveMutex;      // 串行化接收方换钥与解密
+    
     bool keyExchangeComplete;
     mutex keyExchangeMutex;
     
@@ -96,6 +113,7 @@ private:
     void setupServerRoutes();
     // void startPolling();
     void processMessageQueue();
+    void decryptMessage(const json& message, string& plain); // 按epoch换钥后解密，失败时抛出异常
     
     // 路由处理
     void handleKeyExchange(const httplib::Request& req, httplib::Response& res);
@@ -107,6 +125,8 @@ private:
     bool performKeyExchangeAsClient();
     bool sendPublicKey();
     bool receivePublicKey(const json& data);
+    void addPrimeCertificate(json& data); // 在公钥消息中附上p的素性证书
+    bool verifyPrimeCertificate(const json& cert, mpz_t p, mpz_t g);
     bool sendSecret();
     bool receiveSecret(const json& data);
     void completeKeyExchange();
@@ -123,6 +143,9 @@ private:
     
     // 工具方法
     string generateSessionId();
+    static string cipherModeName(MessageEncryptor::CipherMode mode);
+    static string wireEncodingName(MessageEncryptor::WireEncoding encoding);
+    void setWireEncoding(MessageEncryptor::WireEncoding encoding);
     void updateLastActivity();
     bool isSessionValid() const;
     
@@ -1,4 +1,5 @@
 #include "elgamal.hpp"
+#include "../getPrime/primePool.hpp"
 #include <ctime>
 #include <random>
 #include <chrono>
@@ -30,27 +31,43 @@ ElGamal::~ElGamal()
     }
 }
 
+void ElGamal::setGroup(const NamedGroup* group)
+{
+    this->group = group;
+    if (group != nullptr) {
+        bits = group->bits;
+    }
+}
+
 // gen p q g h x y
-void ElGamal::keygen()
+bool ElGamal::keygen(const PrimeSearchCancel* cancel, std::chrono::milliseconds timeout)
 {
-    // 1. 生成素数 p = 2q + 1
-    genSafePrime(p, q, bits);
-    
-    // 2. 选取生成元 g
-    mpz_t h, exp;
-    mpz_inits(h, exp, NULL);
-    mpz_set_ui(exp, 2); // exp = 2
-    
-    while (true) {
-        // 生成随机数 h ∈ [2, p-1]
-        mpz_urandomm(h, state, p);
-        if (mpz_cmp_ui(h, 2) < 0) continue;
+    // 1、2. 标准群直接使用其 p 和 g；否则优先从素数池取出预先生成的 p = 2q + 1 和 g，池为空时现场生成
+    if (group != nullptr) {
+        mpz_set_str(p, group->p, 16);
+        mpz_sub_ui(q, p, 1);
+        mpz_divexact_ui(q, q, 2);
+        mpz_set_ui(g, group->g);
+    } else if (!SafePrimePool::instance().take(bits, p, q, g)) {
+        if (!genSafePrimeParallel(p, q, bits, 0, timeout, cancel)) {
+            return false;
+        }
         
-        // g = h^2 mod p
-        mpz_powm(g, h, exp, p);
-        if (mpz_cmp_ui(g, 1) > 0) break;
+        mpz_t h, exp;
+        mpz_inits(h, exp, NULL);
+        mpz_set_ui(exp, 2); // exp = 2
+        
+        while (true) {
+            // 生成随机数 h ∈ [2, p-1]
+            mpz_urandomm(h, state, p);
+            if (mpz_cmp_ui(h, 2) < 0) continue;
+            
+            // g = h^2 mod p
+            mpz_powm(g, h, exp, p);
+            if (mpz_cmp_ui(g, 1) > 0) break;
+        }
+        mpz_clears(h, exp, NULL);
     }
-    mpz_clears(h, exp, NULL);
     
     // 3. 生成私钥 x ∈ [1, q-1]
     do {
@@ -59,6 +76,12 @@ void ElGamal::keygen()
     
     // 4. 计算公钥 y = g^x mod p
     mpz_powm(y, g, x, p);
+    
+    // 5. p的素性证书，随公钥发送给对方
+    if (!proveSafePrime(p, q, witness)) {
+        witness = 0;
+    }
+    return true;
 }
 
 void ElGamal::generatePrivateKey()
@@ -72,6 +95,12 @@ void ElGamal::generatePrivateKey()
     } while (mpz_cmp_ui(x, 1) < 0);
 }
 
+void ElGamal::getCertificate(mpz_t q_out, unsigned long& witness_out)
+{
+    mpz_set(q_out, q);
+    witness_out = witness;
+}
+
 void ElGamal::setPKG(mpz_t p_in, mpz_t g_in, mpz_t y_in)
 {
     mpz_set(p, p_in);
@@ -1,4 +1,5 @@
 #include "../getPrime/getPrime.hpp"
+#include "../getPrime/namedGroups.hpp"
 
 
 class ElGamal{
@@ -6,10 +7,16 @@ public:
     ElGamal(int bits = 1024);
     ~ElGamal();
 
-    void keygen();
+    /// @brief 使用标准群，之后keygen只生成x和y；nullptr表示每次生成新的安全素数
+    void setGroup(const NamedGroup* group);
+    /// @brief 生成p、g、x、y，素数搜索在所有CPU核上并行
+    /// @return 超时或被取消时返回false，密钥不变
+    bool keygen(const PrimeSearchCancel* cancel = nullptr, std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
     void generatePrivateKey(); 
     void initX();
     void getPKG(mpz_t p_out, mpz_t g_out, mpz_t y_out);  
+    /// @brief p的素性证书(q, 见证a)，见 verifySafePrime；witness为0表示没有证书
+    void getCertificate(mpz_t q_out, unsigned long& witness_out);
     void setPKG(mpz_t p_in, mpz_t g_in, mpz_t y_in);
     void encrypt(mpz_t m, mpz_t c1, mpz_t c2);
     void decrypt(mpz_t c1, mpz_t c2, mpz_t m);
@@ -21,4 +28,6 @@ private:
     gmp_randstate_t state;  
     int bits;
     bool is_cleaned;
+    const NamedGroup* group = nullptr;
+    unsigned long witness = 0; // keygen时生成的Pocklington见证
 };
\ No newline at end of file
@@ -3,8 +3,75 @@
 using namespace std;
 
 #include "elgamal.hpp"
+#include <sstream>
+
+static int failures = 0;
+
+static void check(const string& name, bool ok)
+{
+    cout << (ok ? "✓ " : "✗ ") << name << endl;
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 每个标准群: p为bits位，q = (p - 1) / 2 为素数，g^q ≡ 1 (mod p)
+static void test_named_groups()
+{
+    cout << "=== 标准群 ===" << endl;
+    mpz_t p, q, t;
+    mpz_inits(p, q, t, NULL);
+    stringstream names(namedGroupList());
+    string name;
+    while (getline(names, name, '/')) {
+        const NamedGroup* group = findNamedGroup(name);
+        bool ok = group != nullptr && mpz_set_str(p, group->p, 16) == 0
+                  && mpz_sizeinbase(p, 2) == (size_t)group->bits;
+        if (ok) {
+            mpz_sub_ui(q, p, 1);
+            mpz_divexact_ui(q, q, 2);
+            mpz_set_ui(t, group->g);
+            mpz_powm(t, t, q, p);
+            ok = BailliePSW(q) && mpz_cmp_ui(t, 1) == 0;
+        }
+        check(name, ok);
+    }
+    check("未知名称返回nullptr", findNamedGroup("modp1024") == nullptr);
+    mpz_clears(p, q, t, NULL);
+}
+
+// setGroup后keygen使用该群的p、g，且y在q阶子群中
+static void test_set_group()
+{
+    cout << "=== setGroup + keygen ===" << endl;
+    const NamedGroup* group = findNamedGroup("ffdhe2048");
+    ElGamal elgamal(group->bits);
+    elgamal.setGroup(group);
+    mpz_t p, g, y, q, t, m, c1, c2, d;
+    mpz_inits(p, g, y, q, t, m, c1, c2, d, NULL);
+    bool ok = elgamal.keygen();
+    unsigned long witness = 0;
+    elgamal.getPKG(p, g, y);
+    elgamal.getCertificate(q, witness);
+    mpz_set_str(t, group->p, 16);
+    check("p、g与标准群相同", ok && mpz_cmp(p, t) == 0 && mpz_cmp_ui(g, group->g) == 0);
+    mpz_mul_ui(t, q, 2);
+    mpz_add_ui(t, t, 1);
+    check("证书有效", mpz_cmp(t, p) == 0 && verifySafePrime(p, q, witness));
+    mpz_powm(t, y, q, p);
+    check("y^q ≡ 1 (mod p)", mpz_cmp_ui(y, 1) > 0 && mpz_cmp(y, p) < 0 && mpz_cmp_ui(t, 1) == 0);
+
+    elgamal.getM(m);
+    elgamal.encrypt(m, c1, c2);
+    elgamal.decrypt(c1, c2, d);
+    check("加解密", mpz_cmp(m, d) == 0);
+    mpz_clears(p, g, y, q, t, m, c1, c2, d, NULL);
+}
 
 int main() {
+    test_named_groups();
+    test_set_group();
+
     auto start = std::chrono::high_resolution_clock::now();
     ElGamal elgamal(1024);
     elgamal.keygen();
@@ -35,6 +102,8 @@ int main() {
     duration_ = chrono::duration_cast<std::chrono::microseconds>(end - start);
     cout << "Decryption time: " << duration_.count() << " us" << endl;
     cout << "Decrypted message: " << decrypted_m << endl;
+    check("加解密", mpz_cmp(m, decrypted_m) == 0);
 
-    return 0;
+    cout << endl << (failures == 0 ? "全部通过" : "存在失败用例") << endl;
+    return failures == 0 ? 0 : 1;
 }
\ No newline at end of file
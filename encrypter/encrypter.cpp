@@ -1,18 +1,26 @@
 #include "encrypter.hpp"
 #include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
-MessageEncryptor::MessageEncryptor(int bits) : bits(bits), server(bits), client(bits)
+MessageEncryptor::MessageEncryptor(int bits, CipherMode mode, bool encrypt_then_mac, const NamedGroup* group)
+    : bits(group ? group->bits : bits), cipher_mode(mode), encrypt_then_mac(encrypt_then_mac), wire_encoding(HEX),
+      group(group), server(this->bits), client(this->bits)
 {
+    server.setGroup(group);
 }
 
 MessageEncryptor::~MessageEncryptor()
 {
 }
 
-void MessageEncryptor::SendPKG(mpz_t p, mpz_t g, mpz_t y)
+bool MessageEncryptor::SendPKG(mpz_t p, mpz_t g, mpz_t y, const PrimeSearchCancel* cancel, std::chrono::milliseconds timeout)
 {
-    server.keygen();
+    if (!server.keygen(cancel, timeout)) {
+        return false;
+    }
     server.getPKG(p, g, y);
+    return true;
 }
 
 void MessageEncryptor::GetPKG(mpz_t p, mpz_t g, mpz_t y)
@@ -47,26 +55,40 @@ void MessageEncryptor::SendSecret(mpz_t c1, mpz_t c2)
 
 void MessageEncryptor::SetSM4Key(mpz_t m, int mode)
 {
-    // mpz_t m直接转化为16进制字符串
-    char* hex_char = mpz_get_str(NULL, 16, m);
-    string hex_key(hex_char);
-    free(hex_char); // 释放mpz_get_str分配的内存
-    
-    // 转为大写
-    transform(hex_key.begin(), hex_key.end(), hex_key.begin(), ::toupper);
-    hex_key = hex_key.substr(0, 32); 
+    // 以m的大端字节为共享秘密Z初始化KDF，状态保留下来供之后换钥
+    vector<uint8_t> z((mpz_sizeinbase(m, 2) + 7) / 8);
+    size_t z_len = 0;
+    mpz_export(z.data(), &z_len, 1, 1, 1, 0, m);
+    sm3_kdf_init(mode == 0 ? kdf_server : kdf_client, z.data(), z_len);
+    fill(z.begin(), z.end(), 0);
+
+    RekeySM4(mode);
+}
 
-    // IV 直接为key inverse
-    string iv_key = hex_key;
-    reverse(iv_key.begin(), iv_key.end());
+// 从KDF输出流依次取出 SM4密钥(16) || IV(16) || HMAC密钥(32)
+void MessageEncryptor::RekeySM4(int mode)
+{
+    uint8_t material[16 + 16 + SM3_DIGEST_SIZE];
+    sm3_kdf_next(mode == 0 ? kdf_server : kdf_client, material, sizeof(material));
+    const uint8_t* key = material;
+    const uint8_t* iv = material + 16;
+    const uint8_t* mac_key = material + 32;
 
+    string hex_key(32, '\0'), hex_iv(32, '\0');
+    hex_encode(key, 16, &hex_key[0]);
+    hex_encode(iv, 16, &hex_iv[0]);
     if (mode == 0) {
         sm4_key_server = hex_key;
-        sm4_IV_server = iv_key;
+        sm4_IV_server = hex_iv;
+        sm4_set_key(sm4_ctx_server, key, iv);
+        hmac_sm3_set_key(mac_key_server, mac_key, SM3_DIGEST_SIZE);
     } else {
         sm4_key_client = hex_key;
-        sm4_IV_client = iv_key;
+        sm4_IV_client = hex_iv;
+        sm4_set_key(sm4_ctx_client, key, iv);
+        hmac_sm3_set_key(mac_key_client, mac_key, SM3_DIGEST_SIZE);
     }
+    memset(material, 0, sizeof(material));
 }
 
 void MessageEncryptor::ReceiveSecret(mpz_t c1, mpz_t c2)
@@ -82,61 +104,174 @@ void MessageEncryptor::ReceiveSecret(mpz_t c1, mpz_t c2)
     server.clean(); // 无需再使用server
 }
 
+// 二进制密文格式:
+//   CBC: 密文(PKCS7填充) [|| 32字节HMAC-SM3(密文)，encrypt-then-MAC]
+//   CTR: 16字节计数器初值 || 密文
+//   GCM: 12字节IV || 密文 || 16字节标签
+size_t MessageEncryptor::EncryptedSize(size_t plain_len) const
+{
+    switch (cipher_mode) {
+        case CTR: return 16 + plain_len;
+        case GCM: return SM4_GCM_IV_SIZE + plain_len + SM4_GCM_TAG_SIZE;
+        default: return (plain_len / 16 + 1) * 16 + (encrypt_then_mac ? SM3_DIGEST_SIZE : 0);
+    }
+}
+
 // 使用server的密钥加密消息
-void MessageEncryptor::EncryptMessage(const string &message, string &encrypted_message)
+size_t MessageEncryptor::EncryptMessage(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap)
 {
-    string plain = stringToHex(message);
-    encrypted_message = sm4_encode_CBC(plain, sm4_key_server, sm4_IV_server);   
+    size_t total = EncryptedSize(len);
+    if (out_cap < total) {
+        throw std::invalid_argument("输出缓冲区不足");
+    }
+
+    if (cipher_mode == CBC) {
+        if (out != in) {
+            memmove(out, in, len);
+        }
+        size_t body = sm4_pkcs7_pad(out, len);
+        sm4_cbc_encrypt(sm4_ctx_server.rk_enc, sm4_ctx_server.iv, out, out, body / 16);
+        if (hasMac()) {
+            hmac_sm3(mac_key_server, out, body, out + body);
+        }
+        return total;
+    }
+
+    // 明文后移给IV腾出位置(原地时也成立)，然后原地加密
+    size_t header = cipher_mode == CTR ? 16 : SM4_GCM_IV_SIZE;
+    uint8_t* body = out + header;
+    memmove(body, in, len);
+    randomBytes(out, header);
+    if (cipher_mode == CTR) {
+        sm4_ctr_crypt(sm4_ctx_server.rk_enc, out, body, body, len);
+    } else {
+        sm4_gcm_encrypt(sm4_ctx_server.rk_enc, out, header, nullptr, 0, body, body, len, body + len);
+    }
+    return total;
 }
 
 // 使用client的密钥解密消息
+size_t MessageEncryptor::DecryptMessage(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap)
+{
+    if (cipher_mode == CBC) {
+        // 先验证MAC，通过后才解密
+        if (hasMac()) {
+            if (len < SM3_DIGEST_SIZE) {
+                throw std::invalid_argument("密文长度不足");
+            }
+            len -= SM3_DIGEST_SIZE;
+            uint8_t mac[SM3_DIGEST_SIZE];
+            hmac_sm3(mac_key_client, in, len, mac);
+            if (!hmac_sm3_verify(mac, in + len)) {
+                throw std::runtime_error("HMAC消息认证失败");
+            }
+        }
+        if (len == 0 || len % 16 != 0) {
+            throw std::invalid_argument("CBC密文长度必须是16字节的正整数倍");
+        }
+        if (out_cap < len) {
+            throw std::invalid_argument("输出缓冲区不足");
+        }
+        sm4_cbc_decrypt(sm4_ctx_client.rk_dec, sm4_ctx_client.iv, in, out, len / 16);
+        size_t plain_len = 0;
+        if (!sm4_pkcs7_unpad(out, len, plain_len)) {
+            throw std::invalid_argument("PKCS7填充无效");
+        }
+        return plain_len;
+    }
+
+    size_t header = cipher_mode == CTR ? 16 : SM4_GCM_IV_SIZE;
+    size_t trailer = cipher_mode == GCM ? SM4_GCM_TAG_SIZE : 0;
+    if (len < header + trailer) {
+        throw std::invalid_argument("密文长度不足");
+    }
+    size_t n = len - header - trailer;
+    if (out_cap < n && out != in) {
+        throw std::invalid_argument("输出缓冲区不足");
+    }
+
+    // 原地时先在密文所在位置解密，再前移
+    uint8_t iv[16], tag[SM4_GCM_TAG_SIZE];
+    memcpy(iv, in, header);
+    memcpy(tag, in + header + n, trailer);
+    uint8_t* dst = out == in ? out + header : out;
+    if (cipher_mode == CTR) {
+        sm4_ctr_crypt(sm4_ctx_client.rk_enc, iv, in + header, dst, n);
+    } else if (!sm4_gcm_decrypt(sm4_ctx_client.rk_enc, iv, header, nullptr, 0, in + header, dst, n, tag)) {
+        throw std::runtime_error("GCM消息认证失败");
+    }
+    if (dst != out) {
+        memmove(out, dst, n);
+    }
+    return n;
+}
+
+// 字符串接口: 二进制密文的HEX/Base64编码
+void MessageEncryptor::EncryptMessage(const string &message, string &encrypted_message)
+{
+    string buf(EncryptedSize(message.size()), '\0');
+    EncryptMessage(reinterpret_cast<const uint8_t*>(message.data()), message.size(),
+                   reinterpret_cast<uint8_t*>(&buf[0]), buf.size());
+    encrypted_message = encodeWire(buf);
+}
+
 void MessageEncryptor::DecryptMessage(const string &encrypted_message, string &message)
 {
-    string plain = sm4_decode_CBC(encrypted_message, sm4_key_client, sm4_IV_client);
-    message = hexToString(plain);
+    string buf = decodeWire(encrypted_message);
+    uint8_t* p = reinterpret_cast<uint8_t*>(&buf[0]);
+    buf.resize(DecryptMessage(p, buf.size(), p, buf.size()));
+    message = std::move(buf);
 }
 
-string MessageEncryptor::stringToHex(const string &input) 
+void MessageEncryptor::EncryptMessages(const vector<string>& messages, vector<string>& encrypted_messages)
 {
-    string result;
-    result.reserve(input.length() * 2);
-    
-    for (unsigned char c : input) {
-        result += "0123456789ABCDEF"[c >> 4];
-        result += "0123456789ABCDEF"[c & 0x0F];
+    encrypted_messages.resize(messages.size());
+    if (cipher_mode != CBC) {
+        for (size_t i = 0; i < messages.size(); i++) {
+            EncryptMessage(messages[i], encrypted_messages[i]);
+        }
+        return;
+    }
+
+    // 每条消息先在自己的缓冲区内填充，再一起做CBC加密
+    size_t count = messages.size();
+    vector<string> bufs(count);
+    vector<const uint8_t*> ivs(count, sm4_ctx_server.iv), ins(count);
+    vector<uint8_t*> outs(count);
+    vector<size_t> nblocks(count);
+    for (size_t i = 0; i < count; i++) {
+        bufs[i].resize(EncryptedSize(messages[i].size()));
+        uint8_t* p = reinterpret_cast<uint8_t*>(&bufs[i][0]);
+        memcpy(p, messages[i].data(), messages[i].size());
+        nblocks[i] = sm4_pkcs7_pad(p, messages[i].size()) / 16;
+        ins[i] = outs[i] = p;
+    }
+    sm4_cbc_encrypt_multi(sm4_ctx_server.rk_enc, ivs.data(), ins.data(), outs.data(), nblocks.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        if (hasMac()) {
+            uint8_t* p = reinterpret_cast<uint8_t*>(&bufs[i][0]);
+            hmac_sm3(mac_key_server, p, 16 * nblocks[i], p + 16 * nblocks[i]);
+        }
+        encrypted_messages[i] = encodeWire(bufs[i]);
     }
-    
-    return result;
 }
 
-string MessageEncryptor::hexToString(const string &hex) 
+void MessageEncryptor::randomBytes(uint8_t* out, size_t len)
 {
-    if (hex.length() % 2 != 0) {
-        throw std::invalid_argument("十六进制字符串长度必须为偶数");
-    }
-    
-    string result;
-    result.reserve(hex.length() / 2);
-    
-    for (size_t i = 0; i < hex.length(); i += 2) {
-        char high = hex[i];
-        char low = hex[i + 1];
-        
-        // 转换为数值
-        int highVal = (high >= '0' && high <= '9') ? (high - '0') :
-                     (high >= 'A' && high <= 'F') ? (high - 'A' + 10) :
-                     (high >= 'a' && high <= 'f') ? (high - 'a' + 10) : -1;
-        
-        int lowVal = (low >= '0' && low <= '9') ? (low - '0') :
-                    (low >= 'A' && low <= 'F') ? (low - 'A' + 10) :
-                    (low >= 'a' && low <= 'f') ? (low - 'a' + 10) : -1;
-        
-        if (highVal == -1 || lowVal == -1) {
-            throw std::invalid_argument("无效的十六进制字符");
+    for (size_t i = 0; i < len; i += 4) {
+        uint32_t r = rng();
+        for (size_t j = 0; j < 4 && i + j < len; j++) {
+            out[i + j] = uint8_t(r >> (8 * j));
         }
-        
-        result += static_cast<char>((highVal << 4) | lowVal);
     }
-    
-    return result;
-}
\ No newline at end of file
+}
+
+string MessageEncryptor::encodeWire(const string& bytes) const
+{
+    return wire_encoding == BASE64 ? base64_encode(bytes) : hex_encode(bytes);
+}
+
+string MessageEncryptor::decodeWire(const string& text) const
+{
+    return wire_encoding == BASE64 ? base64_decode(text) : hex_decode(text);
+}
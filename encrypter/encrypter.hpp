@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <random>
 using namespace std;
 
 #include "../sm4/sm34.h"
@@ -7,17 +8,51 @@ using namespace std;
 
 class MessageEncryptor{
 public:
-    MessageEncryptor(int bits);
+    enum CipherMode {
+        CBC, // SM4-CBC，PKCS7填充
+        CTR, // SM4-CTR，每条消息随机计数器初值，无填充
+        GCM  // SM4-GCM，带认证标签，篡改的密文无法解密
+    };
+
+    // 字符串接口中密文的文本编码
+    enum WireEncoding {
+        HEX,   // 大写HEX，旧版本只支持此编码
+        BASE64 // Base64，长度为HEX的2/3
+    };
+
+    /// @param encrypt_then_mac CBC模式下在密文后附加HMAC-SM3，解密前先验证
+    /// @param group 标准安全素数群，非空时忽略bits，SendPKG不再生成素数
+    MessageEncryptor(int bits, CipherMode mode = CBC, bool encrypt_then_mac = false, const NamedGroup* group = nullptr);
     ~MessageEncryptor();
 
-    void SendPKG(mpz_t p, mpz_t g, mpz_t y); 
+    bool SendPKG(mpz_t p, mpz_t g, mpz_t y, const PrimeSearchCancel* cancel = nullptr,
+                 std::chrono::milliseconds timeout = std::chrono::milliseconds(0)); // 生成密钥超时或被取消时返回false
     void GetPKG(mpz_t p, mpz_t g, mpz_t y);
+    void GetPrimeCertificate(mpz_t q, unsigned long& witness) { server.getCertificate(q, witness); } // SendPKG生成的p的证书
     void ReceivePKG(mpz_t p, mpz_t g, mpz_t y); 
     void SendSecret(mpz_t c1, mpz_t c2); 
-    void SetSM4Key(mpz_t m, int mode); // mode = 0, server; mode = 1, client
+    void SetSM4Key(mpz_t m, int mode); // mode = 0, server; mode = 1, client，经SM3 KDF派生密钥、IV和MAC密钥
+    void RekeySM4(int mode); // 从同一KDF输出流取下一组密钥，双方调用次数相同时结果一致；mode = 0 换发送密钥，1 换接收密钥
+    static constexpr const char* KDF_NAME = "sm3-kdf"; // 密钥派生方式，双方必须一致，在/status和公钥消息中告知对方
     void ReceiveSecret(mpz_t c1, mpz_t c2); 
-    void EncryptMessage(const string& message, string& encrypted_message);
-    void DecryptMessage(const string& encrypted_message, string& message);
+    void EncryptMessage(const string& message, string& encrypted_message); // 输出按wire_encoding编码
+    void DecryptMessage(const string& encrypted_message, string& message); // GCM标签/HMAC错误时抛出runtime_error
+
+    // 字节缓冲区接口: 不经过HEX编码，输出写入调用方提供的缓冲区，不分配内存
+    // out 可以与 in 相同(原地加解密)，否则两者不得重叠；返回写入的字节数
+    size_t EncryptedSize(size_t plain_len) const; // 加密输出所需的缓冲区大小
+    size_t EncryptMessage(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap);
+    size_t DecryptMessage(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap);
+
+    // 批量加密，结果与逐条调用EncryptMessage相同；CBC模式下多条消息交错送入多分组内核
+    void EncryptMessages(const vector<string>& messages, vector<string>& encrypted_messages);
+    void SetCipherMode(CipherMode mode) { cipher_mode = mode; }
+    CipherMode GetCipherMode() const { return cipher_mode; }
+    void SetEncryptThenMAC(bool enable) { encrypt_then_mac = enable; }
+    bool GetEncryptThenMAC() const { return encrypt_then_mac; }
+    void SetWireEncoding(WireEncoding encoding) { wire_encoding = encoding; }
+    WireEncoding GetWireEncoding() const { return wire_encoding; }
+    const NamedGroup* GetNamedGroup() const { return group; }
     void GetSM4Key(string& key1, string& key2){
         key1 = sm4_key_server;
         key2 = sm4_key_client;
@@ -25,12 +60,25 @@ public:
     
 private:
     int bits;
+    CipherMode cipher_mode;
+    bool encrypt_then_mac;
+    WireEncoding wire_encoding;
+    const NamedGroup* group;
     ElGamal server; // server, 指'我'作为服务端接受请求
     ElGamal client; // client, 指'我'作为客户端发送请求
     string sm4_key_server;
     string sm4_IV_server;
     string sm4_key_client;
     string sm4_IV_client;
-    string stringToHex(const string& input);   // 字符串转十六进制
-    string hexToString(const string& hex);     // 十六进制转字符串
+    SM4Context sm4_ctx_server; // 轮密钥在SetSM4Key时扩展一次，直到下次换钥
+    SM4Context sm4_ctx_client;
+    HMACSM3Key mac_key_server; // encrypt-then-MAC密钥，与SM4密钥同时设置
+    HMACSM3Key mac_key_client;
+    SM3KDF kdf_server; // 派生上述密钥的KDF状态，换钥时继续取出
+    SM3KDF kdf_client;
+    random_device rng;
+    void randomBytes(uint8_t* out, size_t len); // 生成CTR计数器初值/GCM IV
+    string encodeWire(const string& bytes) const;  // 按wire_encoding编码二进制密文
+    string decodeWire(const string& text) const;   // 解码，格式错误时抛出invalid_argument
+    bool hasMac() const { return cipher_mode == CBC && encrypt_then_mac; } // 仅CBC模式附加HMAC
 };
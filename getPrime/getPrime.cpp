@@ -3,15 +3,19 @@
 #include <ctime>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-// 全局随机数状态
-static gmp_randstate_t global_rand_state;
-static bool rand_state_initialized = false;
+// 随机数状态: 每个线程一个，首次使用时初始化，线程退出时释放。
+// 素数池线程和多个握手线程可以同时调用getPrime/genSafePrime/MillerRabin，互不干扰
+struct ThreadRandState {
+    gmp_randstate_t state;
 
-// 初始化全局随机数状态
-static void init_global_rand_state() {
-    if (!rand_state_initialized) {
-        gmp_randinit_default(global_rand_state);
+    ThreadRandState() {
+        gmp_randinit_default(state);
         
         auto now = std::chrono::high_resolution_clock::now();
         auto duration = now.time_since_epoch();
@@ -19,28 +23,77 @@ static void init_global_rand_state() {
         
         std::random_device rd;
         unsigned long seed = static_cast<unsigned long>(nanoseconds) ^ 
-                            reinterpret_cast<uintptr_t>(&global_rand_state) ^ 
-                            rd() ^ 
+                            reinterpret_cast<uintptr_t>(&state) ^ 
+                            ((unsigned long)rd() << 32) ^ rd() ^ 
                             static_cast<unsigned long>(time(NULL)) ^
                             static_cast<unsigned long>(clock());
         
-        gmp_randseed_ui(global_rand_state, seed);
-        rand_state_initialized = true;
-        
-        // 注册清理函数，程序退出时自动清理
-        atexit([]() {
-            if (rand_state_initialized) {
-                gmp_randclear(global_rand_state);
-                rand_state_initialized = false;
+        gmp_randseed_ui(state, seed);
+    }
+
+    ~ThreadRandState() {
+        gmp_randclear(state);
+    }
+};
+
+// 获取当前线程的随机数状态
+static gmp_randstate_t& get_thread_rand_state() {
+    static thread_local ThreadRandState local;
+    return local.state;
+}
+
+// 筛法预过滤: 用前 SIEVE_PRIME_COUNT 个奇素数筛掉一个区间内的合数，只对剩下的候选做素性检验
+static const int SIEVE_PRIME_COUNT = 2048;  // 最大的约为17881
+static const int SIEVE_WINDOW = 4096;       // 每个随机起点之后检查的奇数个数
+static const int SIEVE_MIN_BITS = 32;       // 更小的数可能等于筛中的素数，直接逐个检验
+
+// 小素数表(不含2)，首次使用时用埃氏筛生成
+static const std::vector<unsigned long>& small_primes() {
+    static const std::vector<unsigned long> primes = [] {
+        std::vector<unsigned long> res;
+        std::vector<bool> composite(20000, false);
+        for (unsigned long i = 3; i < composite.size() && (int)res.size() < SIEVE_PRIME_COUNT; i += 2) {
+            if (composite[i]) {
+                continue;
+            }
+            res.push_back(i);
+            for (unsigned long j = i * i; j < composite.size(); j += 2 * i) {
+                composite[j] = true;
             }
-        });
+        }
+        return res;
+    }();
+    return primes;
+}
+
+// 标记 base + 2j (0 <= j < SIEVE_WINDOW) 中能被小素数整除的数，base为奇数
+// 对每个素数p只做一次大数取模 r = base mod p，之后按步长p在数组上划掉
+// safe为true时同时划掉 2(base + 2j) + 1 能被小素数整除的位置，即 base + 2j ≡ (p - 1) / 2 (mod p)
+void sieveWindow(const mpz_t base, std::vector<char>& composite, bool safe) {
+    composite.assign(SIEVE_WINDOW, 0);
+    for (unsigned long p : small_primes()) {
+        unsigned long r = mpz_fdiv_ui(base, p);
+        unsigned long inv2 = (p + 1) / 2;
+        // 求最小的j使 r + 2j ≡ target (mod p)，即 j ≡ (target - r) * 2^-1
+        for (unsigned long target : {0UL, (p - 1) / 2}) {
+            unsigned long j = (target + p - r) % p * inv2 % p;
+            for (; j < (unsigned long)SIEVE_WINDOW; j += p) {
+                composite[j] = 1;
+            }
+            if (!safe) {
+                break;
+            }
+        }
     }
 }
 
-// 获取全局随机数状态
-static gmp_randstate_t& get_global_rand_state() {
-    init_global_rand_state();
-    return global_rand_state;
+static bool miller_rabin(const mpz_t n, int k, gmp_randstate_t state);
+
+// 以2为底的费马测试: 2^(n-1) ≡ 1 (mod n)，只需一次模幂
+static bool fermat2(const mpz_t n, mpz_t tmp, mpz_t two) {
+    mpz_sub_ui(tmp, n, 1);
+    mpz_powm(tmp, two, tmp, n);
+    return mpz_cmp_ui(tmp, 1) == 0;
 }
 
 // 运算符重载实现
@@ -61,6 +114,12 @@ std::istream &operator>>(std::istream &is, mpz_t &mpz)
 }
 
 bool MillerRabin(mpz_t n, int k)
+{
+    return miller_rabin(n, k, get_thread_rand_state());
+}
+
+// 随机底数取自state，多线程搜索时每个线程使用自己的state
+static bool miller_rabin(const mpz_t n, int k, gmp_randstate_t state)
 {
     if (mpz_cmp_ui(n, 2) < 0) {
         return false;
@@ -91,9 +150,6 @@ bool MillerRabin(mpz_t n, int k)
         r++;
     }
     
-    // 使用全局随机数状态
-    gmp_randstate_t& state = get_global_rand_state();
-    
     // 2. 进行 k 轮测试
     for (int i = 0; i < k; i++) {
         // 生成随机数 a，范围 [2, n-2]
@@ -140,56 +196,381 @@ bool MillerRabin(mpz_t n, int k)
     return true;
 }
 
+// Baillie-PSW 的试除部分只用最小的一批素数，筛过的候选不会在这里被排除
+static const int BPSW_TRIAL_PRIMES = 64;
+
+// 以2为底的强伪素数检验，n为大于2的奇数
+static bool strong_base2(const mpz_t n)
+{
+    mpz_t n_minus_1, d, x;
+    mpz_inits(n_minus_1, d, x, NULL);
+    mpz_sub_ui(n_minus_1, n, 1);
+    mp_bitcnt_t s = mpz_scan1(n_minus_1, 0);
+    mpz_tdiv_q_2exp(d, n_minus_1, s);  // n - 1 = 2^s * d
+    
+    mpz_set_ui(x, 2);
+    mpz_powm(x, x, d, n);
+    bool probable = mpz_cmp_ui(x, 1) == 0 || mpz_cmp(x, n_minus_1) == 0;
+    for (mp_bitcnt_t r = 1; r < s && !probable; r++) {
+        mpz_powm_ui(x, x, 2, n);
+        if (mpz_cmp_ui(x, 1) == 0) {
+            break;  // 出现了1的非平凡平方根
+        }
+        probable = mpz_cmp(x, n_minus_1) == 0;
+    }
+    mpz_clears(n_minus_1, d, x, NULL);
+    return probable;
+}
+
+// 强Lucas伪素数检验(Selfridge参数: D取5, -7, 9, -11, ...中第一个使Jacobi(D/n) = -1的，P = 1，Q = (1 - D) / 4)
+// n为不能被小素数整除的奇数
+static bool strong_lucas(const mpz_t n)
+{
+    // 完全平方数找不到合适的D
+    if (mpz_perfect_square_p(n)) {
+        return false;
+    }
+    
+    mpz_t D, Q, d, U, V, Qk, t;
+    mpz_inits(D, Q, d, U, V, Qk, t, NULL);
+    long D_ui = 5;
+    while (true) {
+        mpz_set_si(D, D_ui);
+        int j = mpz_jacobi(D, n);
+        if (j == -1) {
+            break;
+        }
+        if (j == 0 && mpz_cmpabs_ui(n, labs(D_ui)) != 0) {
+            mpz_clears(D, Q, d, U, V, Qk, t, NULL);
+            return false;  // D与n有公因子
+        }
+        D_ui = D_ui > 0 ? -(D_ui + 2) : -D_ui + 2;
+    }
+    mpz_set_si(Q, (1 - D_ui) / 4);
+    
+    // n + 1 = 2^s * d
+    mpz_add_ui(d, n, 1);
+    mp_bitcnt_t s = mpz_scan1(d, 0);
+    mpz_tdiv_q_2exp(d, d, s);
+    
+    // 按d的二进制位从高到低计算 U_k、V_k、Q^k，初值 k = 1: U_1 = 1, V_1 = P = 1
+    mpz_set_ui(U, 1);
+    mpz_set_ui(V, 1);
+    mpz_mod(Qk, Q, n);
+    for (long i = (long)mpz_sizeinbase(d, 2) - 2; i >= 0; i--) {
+        // k -> 2k: U_2k = U_k V_k, V_2k = V_k^2 - 2Q^k
+        mpz_mul(U, U, V);
+        mpz_mod(U, U, n);
+        mpz_mul(V, V, V);
+        mpz_submul_ui(V, Qk, 2);
+        mpz_mod(V, V, n);
+        mpz_mul(Qk, Qk, Qk);
+        mpz_mod(Qk, Qk, n);
+        if (mpz_tstbit(d, i)) {
+            // k -> k + 1: U_k+1 = (U_k + V_k) / 2, V_k+1 = (D U_k + V_k) / 2 (P = 1)
+            mpz_mul(t, D, U);
+            mpz_add(U, U, V);
+            if (mpz_odd_p(U)) {
+                mpz_add(U, U, n);
+            }
+            mpz_fdiv_q_2exp(U, U, 1);
+            mpz_mod(U, U, n);  // U_k + V_k = n 时结果为n，需要归约为0
+            mpz_add(V, V, t);
+            if (mpz_odd_p(V)) {
+                mpz_add(V, V, n);
+            }
+            mpz_fdiv_q_2exp(V, V, 1);
+            mpz_mod(V, V, n);
+            mpz_mul(Qk, Qk, Q);
+            mpz_mod(Qk, Qk, n);
+        }
+    }
+    
+    // U_d ≡ 0，或存在 0 <= r < s 使 V_(d 2^r) ≡ 0
+    bool probable = mpz_sgn(U) == 0 || mpz_sgn(V) == 0;
+    for (mp_bitcnt_t r = 1; r < s && !probable; r++) {
+        mpz_mul(V, V, V);
+        mpz_submul_ui(V, Qk, 2);
+        mpz_mod(V, V, n);
+        mpz_mul(Qk, Qk, Qk);
+        mpz_mod(Qk, Qk, n);
+        probable = mpz_sgn(V) == 0;
+    }
+    mpz_clears(D, Q, d, U, V, Qk, t, NULL);
+    return probable;
+}
+
+bool BailliePSW(const mpz_t n)
+{
+    if (mpz_cmp_ui(n, 2) < 0) {
+        return false;
+    }
+    if (mpz_cmp_ui(n, 2) == 0) {
+        return true;
+    }
+    if (mpz_even_p(n)) {
+        return false;
+    }
+    
+    // 1. 试除
+    const auto& primes = small_primes();
+    for (int i = 0; i < BPSW_TRIAL_PRIMES; i++) {
+        if (mpz_cmp_ui(n, primes[i]) == 0) {
+            return true;
+        }
+        if (mpz_divisible_ui_p(n, primes[i])) {
+            return false;
+        }
+    }
+    // 小于最大试除素数平方的数已经确定是素数
+    unsigned long limit = primes[BPSW_TRIAL_PRIMES - 1];
+    if (mpz_cmp_ui(n, limit * limit) < 0) {
+        return true;
+    }
+    
+    // 2. 以2为底的强检验  3. 强Lucas检验
+    return strong_base2(n) && strong_lucas(n);
+}
+
+// Pocklington条件(p - 1 = 2q): a^(p-1) ≡ 1 (mod p) 且 gcd(a^((p-1)/q) - 1, p) = gcd(a^2 - 1, p) = 1
+static bool pocklington(const mpz_t p, unsigned long a)
+{
+    mpz_t base, e;
+    mpz_inits(base, e, NULL);
+    mpz_set_ui(base, a);
+    mpz_sub_ui(e, p, 1);
+    mpz_powm(e, base, e, p);
+    bool ok = mpz_cmp_ui(e, 1) == 0;
+    if (ok) {
+        mpz_set_ui(e, a);
+        mpz_mul_ui(e, e, a);
+        mpz_sub_ui(e, e, 1);
+        mpz_gcd(e, e, p);
+        ok = mpz_cmp_ui(e, 1) == 0;
+    }
+    mpz_clears(base, e, NULL);
+    return ok;
+}
+
+// p = 2q + 1 且 p > 5 (q > sqrt(p) - 1 自然成立)
+static bool is_double_plus_one(const mpz_t p, const mpz_t q)
+{
+    mpz_t t;
+    mpz_init(t);
+    mpz_mul_ui(t, q, 2);
+    mpz_add_ui(t, t, 1);
+    bool ok = mpz_cmp(t, p) == 0 && mpz_cmp_ui(p, 5) > 0;
+    mpz_clear(t);
+    return ok;
+}
+
+bool proveSafePrime(const mpz_t p, const mpz_t q, unsigned long& witness)
+{
+    // p为素数时由费马小定理 2^(p-1) ≡ 1，且 p > 3 时 gcd(3, p) = 1，所以 a = 2 总是有效的见证
+    if (!is_double_plus_one(p, q) || !pocklington(p, 2)) {
+        return false;
+    }
+    witness = 2;
+    return true;
+}
+
+bool verifySafePrime(const mpz_t p, const mpz_t q, unsigned long witness)
+{
+    return witness >= 2 && is_double_plus_one(p, q) && BailliePSW(q) && pocklington(p, witness);
+}
+
+// 取一个最高位和最低位为1的bits位随机奇数
+static void random_odd(mpz_t n, gmp_randstate_t state, int bits) {
+    mpz_urandomb(n, state, bits);
+    mpz_setbit(n, bits - 1);  // 确保最高位为 1（保证位数）
+    mpz_setbit(n, 0);         // 确保最低位为 1（保证为奇数）
+}
+
 void getPrime(mpz_t p, int bits)
 {
-    // 使用全局随机数状态
-    gmp_randstate_t& state = get_global_rand_state();
+    gmp_randstate_t& state = get_thread_rand_state();
     
     mpz_t candidate;
     mpz_init(candidate);
     
-    do {
-        mpz_urandomb(candidate, state, bits);
-        
-        // 确保最高位为 1（保证位数）
-        mpz_setbit(candidate, bits - 1);
-        
-        // 确保最低位为 1（保证为奇数）
-        mpz_setbit(candidate, 0);
+    if (bits < SIEVE_MIN_BITS) {
+        do {
+            random_odd(candidate, state, bits);
+        } while (!BailliePSW(candidate));
+        mpz_set(p, candidate);
+        mpz_clear(candidate);
+        return;
+    }
+    
+    mpz_t base;
+    mpz_init(base);
+    std::vector<char> composite;
+    bool found = false;
+    
+    while (!found) {
+        random_odd(base, state, bits);
+        sieveWindow(base, composite);
         
-    } while (!MillerRabin(candidate, 40));  // 使用 40 轮测试，错误概率约为 2^-80
+        for (int j = 0; j < SIEVE_WINDOW && !found; j++) {
+            if (composite[j]) {
+                continue;
+            }
+            mpz_add_ui(candidate, base, 2 * j);
+            if (mpz_sizeinbase(candidate, 2) != (size_t)bits) {
+                break;  // 越过了位数上限，换一个起点
+            }
+            found = BailliePSW(candidate);
+        }
+    }
     
     mpz_set(p, candidate);
     
+    mpz_clear(base);
     mpz_clear(candidate);
 }
 
-void genSafePrime(mpz_t p, mpz_t q, int bits)
+// 联合筛: q 和 2q + 1 都不能被小素数整除
+// 幸存者中绝大多数会被第一次费马测试排除，所以先做两次单次模幂的费马测试，
+// 都通过(此时几乎必为安全素数)才对q做 Baillie-PSW；q为素数时 2^(p-1) ≡ 1 且 3 ∤ p 即是p的Pocklington证明
+// (见证 a = 2，3 已在筛中排除)，p不必再做概率检验
+// 每个候选之前检查stop，被中止时返回false
+static bool safe_prime_search(mpz_t p, mpz_t q, int bits, gmp_randstate_t state, const std::function<bool()>& stop)
 {
-    // 使用全局随机数状态
-    gmp_randstate_t& state = get_global_rand_state();
-    
-    mpz_t candidate_q, candidate_p;
-    mpz_init(candidate_q);
-    mpz_init(candidate_p);
+    mpz_t base, tmp, two;
+    mpz_inits(base, tmp, two, NULL);
+    mpz_set_ui(two, 2);
+    std::vector<char> composite;
+    bool found = false;
     
+    while (!found && !stop()) {
+        random_odd(base, state, bits - 1);
+        sieveWindow(base, composite, true);
+        
+        for (int j = 0; j < SIEVE_WINDOW && !found; j++) {
+            if (composite[j]) {
+                continue;
+            }
+            if (stop()) {
+                break;
+            }
+            mpz_add_ui(q, base, 2 * j);
+            if (mpz_sizeinbase(q, 2) != (size_t)(bits - 1)) {
+                break;
+            }
+            if (!fermat2(q, tmp, two)) {
+                continue;
+            }
+            mpz_mul_ui(p, q, 2);
+            mpz_add_ui(p, p, 1);
+            found = fermat2(p, tmp, two)
+                    && BailliePSW(q);
+        }
+    }
+    mpz_clears(base, tmp, two, NULL);
+    return found;
+}
+
+// 位数太小不能用筛时逐个生成，每个候选之前检查stop，被中止时返回false
+static bool small_safe_prime_search(mpz_t p, mpz_t q, int bits, gmp_randstate_t state, const std::function<bool()>& stop)
+{
+    unsigned long witness;
     do {
         // 生成 (bits-1) 位的素数 q
         do {
-            mpz_urandomb(candidate_q, state, bits - 1);
-            mpz_setbit(candidate_q, bits - 2);  // 确保最高位为 1
-            mpz_setbit(candidate_q, 0);         // 确保为奇数
-        } while (!MillerRabin(candidate_q, 40));
+            if (stop()) {
+                return false;
+            }
+            random_odd(q, state, bits - 1);
+        } while (!BailliePSW(q));
         
         // 计算 p = 2q + 1
-        mpz_mul_ui(candidate_p, candidate_q, 2);
-        mpz_add_ui(candidate_p, candidate_p, 1);
+        mpz_mul_ui(p, q, 2);
+        mpz_add_ui(p, p, 1);
         
-    } while (!MillerRabin(candidate_p, 40));  // 检查 p 是否也是素数
+    } while (!proveSafePrime(p, q, witness));  // 证明 p 也是素数
+    return true;
+}
+
+void genSafePrime(mpz_t p, mpz_t q, int bits)
+{
+    gmp_randstate_t& state = get_thread_rand_state();
+    
+    mpz_t candidate_q, candidate_p;
+    mpz_init(candidate_q);
+    mpz_init(candidate_p);
+    
+    auto never = [] { return false; };
+    if (bits - 1 < SIEVE_MIN_BITS) {
+        small_safe_prime_search(candidate_p, candidate_q, bits, state, never);
+    } else {
+        safe_prime_search(candidate_p, candidate_q, bits, state, never);
+    }
     
     mpz_set(q, candidate_q);
     mpz_set(p, candidate_p);
     
     mpz_clear(candidate_q);
     mpz_clear(candidate_p);
-}
\ No newline at end of file
+}
+
+bool genSafePrimeParallel(mpz_t p, mpz_t q, int bits, int threads,
+                          std::chrono::milliseconds timeout, const PrimeSearchCancel* cancel)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::atomic<bool> found(false);
+    std::mutex result_mutex;
+    auto stop = [&] {
+        return found.load(std::memory_order_relaxed)
+               || (cancel != nullptr && cancel->isCancelled())
+               || (timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline);
+    };
+    
+    if (bits - 1 < SIEVE_MIN_BITS) {
+        // 很快，不值得并行；结果先写入临时变量，被中止时p、q不变
+        mpz_t local_p, local_q;
+        mpz_inits(local_p, local_q, NULL);
+        bool ok = small_safe_prime_search(local_p, local_q, bits, get_thread_rand_state(), stop);
+        if (ok) {
+            mpz_set(p, local_p);
+            mpz_set(q, local_q);
+        }
+        mpz_clears(local_p, local_q, NULL);
+        return ok;
+    }
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    // 各线程的种子取自调用线程的随机数状态，工作线程只使用自己的状态
+    std::vector<unsigned long> seeds(threads);
+    gmp_randstate_t& caller_state = get_thread_rand_state();
+    for (auto& seed : seeds) {
+        seed = gmp_urandomb_ui(caller_state, 8 * sizeof(unsigned long));
+    }
+    
+    // 各线程独立搜索，第一个找到的写回结果，其余线程在下一个候选前看到found后退出
+    auto worker = [&](int id) {
+        gmp_randstate_t state;
+        gmp_randinit_default(state);
+        gmp_randseed_ui(state, seeds[id]);
+        mpz_t local_p, local_q;
+        mpz_inits(local_p, local_q, NULL);
+        if (safe_prime_search(local_p, local_q, bits, state, stop) && !found.exchange(true)) {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            mpz_set(p, local_p);
+            mpz_set(q, local_q);
+        }
+        mpz_clears(local_p, local_q, NULL);
+        gmp_randclear(state);
+    };
+    
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(worker, i);
+    }
+    worker(0);  // 调用线程也参与搜索
+    for (auto& t : workers) {
+        t.join();
+    }
+    return found.load();
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include <gmp.h>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <vector>
 #include <iostream>
 
 /// @brief Miller-Rabin primality test
@@ -9,6 +12,21 @@
 /// @return 
 bool MillerRabin(mpz_t n, int k = 20);
 
+/// @brief Baillie-PSW 素性检验: 试除、以2为底的强检验、强Lucas检验
+///        约相当于3次模幂，目前没有已知的反例；密钥生成默认使用，需要指定轮数时用 MillerRabin
+/// @param n 
+/// @return 
+bool BailliePSW(const mpz_t n);
+
+/// @brief Pocklington证明: q为素数时，若 a^(p-1) ≡ 1 (mod p) 且 gcd(a^2 - 1, p) = 1，则 p = 2q + 1 为素数
+///        只需一次模幂，(q, witness) 即为p的素性证书
+/// @param witness 输出见证a
+/// @return p != 2q + 1 或 p为合数时返回false；不检查q本身
+bool proveSafePrime(const mpz_t p, const mpz_t q, unsigned long& witness);
+
+/// @brief 验证素性证书: p = 2q + 1、q 通过 BailliePSW、见证满足Pocklington条件
+bool verifySafePrime(const mpz_t p, const mpz_t q, unsigned long witness);
+
 /// @brief Gen a random prime number with given bits
 /// @param p 
 /// @param bits 
@@ -21,6 +39,30 @@ void getPrime(mpz_t p, int bits);
 /// @param bits 
 void genSafePrime(mpz_t p, mpz_t q, int bits);
 
+/// @brief 素数搜索的取消标志，可在任意线程中调用cancel
+class PrimeSearchCancel {
+public:
+    void cancel() { cancelled.store(true); }
+    void reset() { cancelled.store(false); }
+    bool isCancelled() const { return cancelled.load(); }
+private:
+    std::atomic<bool> cancelled{false};
+};
+
+/// @brief 多线程生成安全素数p = 2q + 1，任一线程找到后其余线程随即停止
+/// @param threads 线程数(含调用线程)，0表示CPU核数
+/// @param timeout 超时时间，0表示不限
+/// @param cancel 取消标志，可为nullptr
+/// @return 找到时返回true；超时或被取消时返回false，p、q不变
+bool genSafePrimeParallel(mpz_t p, mpz_t q, int bits, int threads = 0,
+                          std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+                          const PrimeSearchCancel* cancel = nullptr);
+
+/// @brief 素数搜索使用的筛(导出供测试): 标记 base + 2j (0 <= j < composite.size()) 中能被前2048个奇素数整除的数
+/// @param base 奇数
+/// @param safe 为true时同时标记 2(base + 2j) + 1 能被整除的位置
+void sieveWindow(const mpz_t base, std::vector<char>& composite, bool safe = false);
+
 // 运算符重载声明
 std::ostream &operator<<(std::ostream &os, const mpz_t &mpz);
 // std::istream &operator>>(std::istream &is, mpz_t &mpz);
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+
+/// @brief 公开的标准安全素数群 p = 2q + 1，不必每次握手生成素数
+struct NamedGroup {
+    const char* name;  // modp2048、ffdhe2048 等
+    int bits;
+    const char* p;     // 十六进制
+    unsigned long g;
+};
+
+/// @brief 按名称查找，未知名称返回nullptr
+const NamedGroup* findNamedGroup(const std::string& name);
+
+/// @brief 所有群名称，以'/'分隔，用于帮助信息
+std::string namedGroupList();
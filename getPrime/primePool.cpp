@@ -0,0 +1,242 @@
+#include "primePool.hpp"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+// 文件格式: 每行一组 "bits p q g"，数值为十六进制
+// 加载时重新检验，文件被改坏的组直接丢弃
+
+static std::string to_hex(const mpz_t n)
+{
+    char *str = mpz_get_str(nullptr, 16, n);
+    std::string res(str);
+    free(str);
+    return res;
+}
+
+// 检查 p = 2q + 1 为bits位安全素数(q用BailliePSW，p用Pocklington证明)，且 1 < g < p、g^q ≡ 1 (mod p)
+static bool check_group(int bits, const SafePrimeGroup& group)
+{
+    mpz_t p, q, g, tmp;
+    mpz_inits(p, q, g, tmp, NULL);
+    bool ok = mpz_set_str(p, group.p.c_str(), 16) == 0
+              && mpz_set_str(q, group.q.c_str(), 16) == 0
+              && mpz_set_str(g, group.g.c_str(), 16) == 0
+              && mpz_sizeinbase(p, 2) == (size_t)bits;
+    if (ok) {
+        mpz_mul_ui(tmp, q, 2);
+        mpz_add_ui(tmp, tmp, 1);
+        ok = mpz_cmp(tmp, p) == 0 && mpz_cmp_ui(g, 1) > 0 && mpz_cmp(g, p) < 0;
+    }
+    if (ok) {
+        mpz_powm(tmp, g, q, p);
+        unsigned long witness;
+        ok = mpz_cmp_ui(tmp, 1) == 0 && BailliePSW(q) && proveSafePrime(p, q, witness);
+    }
+    mpz_clears(p, q, g, tmp, NULL);
+    return ok;
+}
+
+SafePrimePool& SafePrimePool::instance()
+{
+    static SafePrimePool pool;
+    return pool;
+}
+
+SafePrimePool::~SafePrimePool()
+{
+    stop();
+}
+
+void SafePrimePool::start(const std::string& path, int capacity)
+{
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        this->path = path;
+        this->capacity = capacity;
+        groups.clear(); // 只保留新文件中的组，已登记的位数继续补充
+        running = true;
+    }
+    load();
+    cancel.reset();
+    worker = std::thread(&SafePrimePool::refillLoop, this);
+}
+
+void SafePrimePool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cancel.cancel();
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void SafePrimePool::reserve(int bits)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    reserved.insert(bits);
+    groups[bits];
+    cv.notify_all();
+}
+
+bool SafePrimePool::take(int bits, mpz_t p, mpz_t q, mpz_t g)
+{
+    SafePrimeGroup group;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = groups.find(bits);
+        if (it == groups.end() || it->second.empty()) {
+            return false;
+        }
+        group = it->second.front();
+        it->second.pop_front();
+        dirty = true; // 由补充线程从文件中删除，握手线程不等待磁盘
+    }
+    cv.notify_all();
+    mpz_set_str(p, group.p.c_str(), 16);
+    mpz_set_str(q, group.q.c_str(), 16);
+    mpz_set_str(g, group.g.c_str(), 16);
+    return true;
+}
+
+size_t SafePrimePool::available(int bits)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = groups.find(bits);
+    return it == groups.end() ? 0 : it->second.size();
+}
+
+void SafePrimePool::load()
+{
+    std::ifstream in(path);
+    if (path.empty() || !in) {
+        return;
+    }
+    std::string line;
+    std::map<int, std::deque<SafePrimeGroup>> loaded;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        int bits = 0;
+        SafePrimeGroup group;
+        if (fields >> bits >> group.p >> group.q >> group.g
+            && (int)loaded[bits].size() < capacity && check_group(bits, group)) {
+            loaded[bits].push_back(group);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto& entry : loaded) {
+        auto& pool = groups[entry.first];
+        for (auto& group : entry.second) {
+            if ((int)pool.size() < capacity) {
+                pool.push_back(group);
+            }
+        }
+    }
+}
+
+void SafePrimePool::save()
+{
+    // 在锁内取快照，锁外写文件，写入期间take不被阻塞
+    std::ostringstream text;
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (path.empty()) {
+            return;
+        }
+        for (auto& entry : groups) {
+            for (auto& group : entry.second) {
+                text << entry.first << ' ' << group.p << ' ' << group.q << ' ' << group.g << '\n';
+            }
+        }
+        file = path;
+    }
+
+    // 先写临时文件再改名，写到一半时进程退出也不会损坏原文件
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << text.str();
+        if (!out) {
+            return;
+        }
+    }
+    std::rename(tmp.c_str(), file.c_str());
+}
+
+int SafePrimePool::nextBits()
+{
+    for (int bits : reserved) {
+        if ((int)groups[bits].size() < capacity) {
+            return bits;
+        }
+    }
+    return 0;
+}
+
+void SafePrimePool::refillLoop()
+{
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, 0, 19); // Linux上只作用于当前线程，握手线程不受影响
+#endif
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    std::random_device rd;
+    gmp_randseed_ui(state, ((unsigned long)rd() << 32) ^ rd());
+
+    mpz_t p, q, g, h;
+    mpz_inits(p, q, g, h, NULL);
+    while (true) {
+        int bits;
+        bool flush, stopping;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return !running || dirty || nextBits() != 0; });
+            flush = dirty;
+            dirty = false;
+            stopping = !running;
+            bits = stopping ? 0 : nextBits();
+        }
+        // 取出或新增的组在开始下一次搜索前写回文件，停止时也写入最后一次修改
+        if (flush) {
+            save();
+        }
+        if (stopping) {
+            break;
+        }
+        if (bits == 0) {
+            continue;
+        }
+
+        // 单线程搜索，不与握手争抢CPU
+        if (!genSafePrimeParallel(p, q, bits, 1, std::chrono::milliseconds(0), &cancel)) {
+            continue;
+        }
+        // g = h^2 mod p，与ElGamal::keygen相同
+        do {
+            mpz_urandomm(h, state, p);
+            mpz_powm_ui(g, h, 2, p);
+        } while (mpz_cmp_ui(h, 2) < 0 || mpz_cmp_ui(g, 1) <= 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto& pool = groups[bits];
+            if ((int)pool.size() < capacity) {
+                pool.push_back({to_hex(p), to_hex(q), to_hex(g)});
+                dirty = true;
+            }
+        }
+    }
+    mpz_clears(p, q, g, h, NULL);
+    gmp_randclear(state);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "getPrime.hpp"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+/// @brief 预先生成的安全素数群 p = 2q + 1，g 为 q 阶子群的生成元
+struct SafePrimeGroup {
+    std::string p, q, g; // 十六进制
+};
+
+/// @brief 安全素数池: 后台低优先级线程为每个登记的位数预先生成 capacity 组 (p, q, g)，
+///        并保存到本地文件，重启后直接加载。每组只取出使用一次。
+class SafePrimePool {
+public:
+    /// @brief 进程内共享的素数池，start之前为空，take总是返回false
+    static SafePrimePool& instance();
+
+    SafePrimePool() = default;
+    ~SafePrimePool();
+
+    SafePrimePool(const SafePrimePool&) = delete;
+    SafePrimePool& operator=(const SafePrimePool&) = delete;
+
+    /// @brief 加载文件中的素数并启动后台补充线程
+    /// @param path 持久化文件，空字符串表示只保存在内存中
+    /// @param capacity 每个位数保留的组数
+    void start(const std::string& path, int capacity);
+
+    /// @brief 停止后台线程(正在进行的搜索会被取消)
+    void stop();
+
+    /// @brief 登记需要预生成的位数；文件中其他位数的组仍可取出，但用完后不再补充
+    void reserve(int bits);
+
+    /// @brief 取出一组bits位的群，池为空时返回false，由调用方自行生成
+    bool take(int bits, mpz_t p, mpz_t q, mpz_t g);
+
+    /// @brief 当前可用的组数
+    size_t available(int bits);
+
+private:
+    void refillLoop();
+    void load();
+    void save();                           // 只在补充线程中调用，不能持有mtx，文件在锁外写入
+    int nextBits();                        // 需要补充的位数，没有时返回0；调用时需持有mtx
+
+    std::map<int, std::deque<SafePrimeGroup>> groups;
+    std::set<int> reserved;
+    bool dirty = false;                    // groups与文件不一致，由补充线程写回
+    std::string path;
+    int capacity = 0;
+    bool running = false;
+    PrimeSearchCancel cancel;
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
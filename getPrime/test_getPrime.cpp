@@ -1,68 +1,377 @@
 #include "getPrime.hpp"
+#include "primePool.hpp"
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
-int main() {
-    // 初始化 GMP 变量
-    mpz_t prime;
-    mpz_init(prime);
-    
-    // 测试不同位数的素数生成
-    std::vector<int> test_bits = {32, 64, 128, 256, 512, 1024};
+static int failures = 0;
+
+static void check(const std::string& name, bool ok)
+{
+    std::cout << (ok ? "✓ " : "✗ ") << name << std::endl;
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 用GMP的素性检验作为参照
+static bool is_prime(const mpz_t n)
+{
+    return mpz_probab_prime_p(n, 30) > 0;
+}
+
+// 筛所用的前2048个奇素数
+static std::vector<unsigned long> sieve_primes()
+{
+    std::vector<unsigned long> primes;
+    mpz_t p;
+    mpz_init_set_ui(p, 2);
+    while (primes.size() < 2048) {
+        mpz_nextprime(p, p);
+        primes.push_back(mpz_get_ui(p));
+    }
+    mpz_clear(p);
+    return primes;
+}
+
+static bool has_small_factor(const mpz_t n, const std::vector<unsigned long>& primes)
+{
+    for (unsigned long p : primes) {
+        if (mpz_divisible_ui_p(n, p)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 筛标记的位置与逐个试除的结果完全一致
+static void test_sieve()
+{
+    std::cout << "=== 筛法与试除对比 ===" << std::endl;
+    auto primes = sieve_primes();
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    mpz_t base, n, m;
+    mpz_inits(base, n, m, NULL);
+    for (bool safe : {false, true}) {
+        bool ok = true;
+        for (int round = 0; round < 4 && ok; round++) {
+            mpz_urandomb(base, state, 256);
+            mpz_setbit(base, 0);
+            std::vector<char> composite;
+            sieveWindow(base, composite, safe);
+            for (size_t j = 0; j < composite.size() && ok; j++) {
+                mpz_add_ui(n, base, 2 * j);
+                bool expected = has_small_factor(n, primes);
+                if (safe) {
+                    mpz_mul_ui(m, n, 2);
+                    mpz_add_ui(m, m, 1);
+                    expected = expected || has_small_factor(m, primes);
+                }
+                ok = (composite[j] != 0) == expected;
+            }
+        }
+        check(safe ? "联合筛(q和2q+1)" : "普通筛", ok);
+    }
+    mpz_clears(base, n, m, NULL);
+    gmp_randclear(state);
+}
+
+// 位数准确且为素数，覆盖 SIEVE_MIN_BITS = 32 两侧
+static void test_generate()
+{
+    std::cout << "=== 素数生成 ===" << std::endl;
+    mpz_t p, q, t;
+    mpz_inits(p, q, t, NULL);
+    for (int bits : {16, 31, 32, 33, 64, 256, 1024}) {
+        bool ok = true;
+        for (int i = 0; i < 8 && ok; i++) {
+            getPrime(p, bits);
+            ok = mpz_sizeinbase(p, 2) == (size_t)bits && is_prime(p);
+        }
+        check("getPrime " + std::to_string(bits) + "位", ok);
+    }
+    for (int bits : {16, 32, 33, 34, 128, 512}) {
+        bool ok = true;
+        for (int i = 0; i < 4 && ok; i++) {
+            genSafePrime(p, q, bits);
+            mpz_mul_ui(t, q, 2);
+            mpz_add_ui(t, t, 1);
+            ok = mpz_sizeinbase(p, 2) == (size_t)bits && mpz_cmp(t, p) == 0 && is_prime(p) && is_prime(q);
+        }
+        check("genSafePrime " + std::to_string(bits) + "位", ok);
+    }
+    mpz_clears(p, q, t, NULL);
+}
+
+// BailliePSW 与GMP的结果一致，且拒绝已知的伪素数
+static void test_bpsw()
+{
+    std::cout << "=== Baillie-PSW ===" << std::endl;
+    mpz_t n;
+    mpz_init(n);
+    bool ok = true;
+    for (unsigned long i = 0; i < 2000000 && ok; i++) {
+        mpz_set_ui(n, i);
+        ok = BailliePSW(n) == is_prime(n);
+    }
+    check("n < 2000000 与 mpz_probab_prime_p 一致", ok);
     
-    std::cout << "=== getPrime 函数性能测试 ===" << std::endl;
-    std::cout << "位数\t时间(毫秒)\t生成的素数" << std::endl;
-    std::cout << "--------------------------------------------" << std::endl;
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    ok = true;
+    for (int i = 0; i < 20000 && ok; i++) {
+        mpz_urandomb(n, state, 64 + i % 900);
+        ok = BailliePSW(n) == is_prime(n);
+    }
+    check("64-963位随机数与 mpz_probab_prime_p 一致", ok);
+    gmp_randclear(state);
     
-    for (int bits : test_bits) {
-        // 开始计时
-        auto start = std::chrono::high_resolution_clock::now();
-        
-        // 调用 getPrime 函数
-        getPrime(prime, bits);
-        
-        // 结束计时
-        auto end = std::chrono::high_resolution_clock::now();
-        
-        // 计算毫秒数
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        
-        // 输出结果
-        std::cout << bits << "\t" << duration.count() << "ms\t\t" << prime << std::endl;
-        
-        // 验证生成的数确实是素数（使用 Miller-Rabin 测试）
-        if (MillerRabin(prime, 20)) {
-            std::cout << "✓ 验证通过：生成的数是素数" << std::endl;
-        } else {
-            std::cout << "✗ 验证失败：生成的数不是素数" << std::endl;
+    // 以2为底的强伪素数、Lucas伪素数、Carmichael数、完全平方数
+    const char* pseudoprimes[] = {
+        "2047", "3277", "4033", "4681", "8321", "3215031751", "2152302898747", "3474749660383",
+        "341550071728321", "3825123056546413051", "318665857834031151167461",
+        "5459", "5777", "10877", "16109", "18971", "561", "1105", "1000006000009",
+    };
+    ok = true;
+    for (const char* s : pseudoprimes) {
+        mpz_set_str(n, s, 10);
+        if (BailliePSW(n)) {
+            std::cout << "  误判为素数: " << s << std::endl;
+            ok = false;
         }
-        std::cout << std::endl;
     }
+    check("拒绝已知伪素数", ok);
+    mpz_clear(n);
+}
+
+// Pocklington证书: 只有 p = 2q + 1、q为素数、见证有效时才通过
+static void test_certificate()
+{
+    std::cout << "=== 安全素数证书 ===" << std::endl;
+    mpz_t p, q, t;
+    mpz_inits(p, q, t, NULL);
+    unsigned long witness = 0;
     
-    // 多次测试同一位数，计算平均时间
-    std::cout << "=== 256位素数生成时间统计（10次测试）===" << std::endl;
-    int test_count = 10;
-    int test_bits_avg = 256;
-    long total_time = 0;
+    genSafePrime(p, q, 512);
+    check("有效的 (p, q)", proveSafePrime(p, q, witness) && witness == 2 && verifySafePrime(p, q, witness));
+    check("见证为0或1", !verifySafePrime(p, q, 0) && !verifySafePrime(p, q, 1));
     
-    for (int i = 0; i < test_count; i++) {
-        auto start = std::chrono::high_resolution_clock::now();
-        getPrime(prime, test_bits_avg);
-        auto end = std::chrono::high_resolution_clock::now();
-        
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        long time_ms = duration.count();
-        total_time += time_ms;
-        
-        std::cout << "第" << (i+1) << "次: " << time_ms << "ms" << std::endl;
-    }
+    mpz_add_ui(t, q, 2);
+    check("p != 2q + 1", !proveSafePrime(p, t, witness) && !verifySafePrime(p, t, 2));
     
-    double avg_time = (double)total_time / test_count;
-    std::cout << "平均时间: " << avg_time << "ms" << std::endl;
+    // q为素数但 3 | p = 2q + 1 (q ≡ 1 mod 3)
+    getPrime(q, 256);
+    while (mpz_fdiv_ui(q, 3) != 1) {
+        mpz_nextprime(q, q);
+    }
+    mpz_mul_ui(p, q, 2);
+    mpz_add_ui(p, p, 1);
+    check("3 | p", !proveSafePrime(p, q, witness) && !verifySafePrime(p, q, 2));
     
-    // 清理 GMP 变量
-    mpz_clear(prime);
+    // p = 2q + 1 为素数但q为合数
+    getPrime(p, 256);
+    while (true) {
+        mpz_sub_ui(q, p, 1);
+        mpz_divexact_ui(q, q, 2);
+        if (!is_prime(q)) {
+            break;
+        }
+        mpz_nextprime(p, p);
+    }
+    check("q为合数", !verifySafePrime(p, q, 2));
     
-    return 0;
-}
\ No newline at end of file
+    // 小的安全素数 p = 23, q = 11
+    mpz_set_ui(p, 23);
+    mpz_set_ui(q, 11);
+    check("p = 23", proveSafePrime(p, q, witness) && verifySafePrime(p, q, witness));
+    mpz_clears(p, q, t, NULL);
+}
+
+// 被取消或超时时返回false且不修改p、q，正常时结果为安全素数
+static void test_parallel()
+{
+    std::cout << "=== 并行搜索与取消 ===" << std::endl;
+    mpz_t p, q;
+    mpz_inits(p, q, NULL);
+    for (int bits : {16, 512}) {
+        mpz_set_ui(p, 7);
+        mpz_set_ui(q, 3);
+        PrimeSearchCancel cancel;
+        cancel.cancel();
+        bool ret = genSafePrimeParallel(p, q, bits, 2, std::chrono::milliseconds(0), &cancel);
+        check("已取消 " + std::to_string(bits) + "位", !ret && mpz_cmp_ui(p, 7) == 0 && mpz_cmp_ui(q, 3) == 0);
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ret = genSafePrimeParallel(p, q, 4096, 2, std::chrono::milliseconds(100));
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    check("4096位100ms超时", !ret && mpz_cmp_ui(p, 7) == 0 && elapsed < 2000);
+    for (int bits : {16, 512}) {
+        ret = genSafePrimeParallel(p, q, bits, 2);
+        check("并行生成 " + std::to_string(bits) + "位", ret && mpz_sizeinbase(p, 2) == (size_t)bits && is_prime(p) && is_prime(q));
+    }
+    mpz_clears(p, q, NULL);
+}
+
+// 多个线程同时调用使用内部随机数状态的接口(素数池线程与握手线程并发的情形)
+static void test_concurrent()
+{
+    std::cout << "=== 多线程同时生成 ===" << std::endl;
+    const int threads = 4;
+    std::vector<int> ok(threads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&ok, t] {
+            mpz_t p, q;
+            mpz_inits(p, q, NULL);
+            bool good = true;
+            for (int i = 0; i < 5 && good; i++) {
+                getPrime(p, 256);
+                good = is_prime(p) && MillerRabin(p, 20);
+                genSafePrime(p, q, 128);
+                good = good && is_prime(p) && is_prime(q);
+            }
+            ok[t] = good;
+            mpz_clears(p, q, NULL);
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    bool all = true;
+    for (int v : ok) {
+        all = all && v;
+    }
+    check(std::to_string(threads) + "个线程同时调用getPrime/genSafePrime/MillerRabin", all);
+}
+
+static std::string hex(const mpz_t n)
+{
+    char* str = mpz_get_str(nullptr, 16, n);
+    std::string res(str);
+    free(str);
+    return res;
+}
+
+// 一组128位的 "bits p q g" 文件行，g = 4 为二次剩余
+static std::string pool_line(mpz_t p, mpz_t q)
+{
+    genSafePrime(p, q, 128);
+    return "128 " + hex(p) + " " + hex(q) + " 4\n";
+}
+
+static int count_lines(const std::string& path)
+{
+    std::ifstream in(path);
+    std::string line;
+    int n = 0;
+    while (std::getline(in, line)) {
+        n++;
+    }
+    return n;
+}
+
+// 文件由补充线程写回，最多等待1秒
+static bool wait_lines(const std::string& path, int n)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (count_lines(path) != n && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return count_lines(path) == n;
+}
+
+// 素数池: 加载时丢弃坏行、取出即从文件删除、容量上限、stop中断正在进行的搜索
+static void test_pool()
+{
+    std::cout << "=== 安全素数池 ===" << std::endl;
+    char tmpl[] = "/tmp/safe_primes_XXXXXX";
+    int fd = mkstemp(tmpl);
+    if (fd < 0) {
+        check("创建临时文件", false);
+        return;
+    }
+    close(fd);
+    std::string path = tmpl;
+    SafePrimePool& pool = SafePrimePool::instance();
+    mpz_t p, q, taken;
+    mpz_inits(p, q, taken, NULL);
+
+    std::string good1 = pool_line(p, q);
+    std::string first = hex(p);
+    std::string good2 = pool_line(p, q);
+    mpz_add_ui(p, p, 2);
+    std::string tampered = "128 " + hex(p) + " " + hex(q) + " 4\n";
+    std::string wrong_size = "256 " + good2.substr(4);
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << good1 << "not a group\n" << wrong_size << tampered << good2;
+    }
+    pool.start(path, 8);
+    check("加载时丢弃损坏和位数不符的行", pool.available(128) == 2 && pool.available(256) == 0);
+
+    mpz_set_ui(q, 0);
+    bool ok = pool.take(128, p, q, taken) && hex(p) == first && mpz_cmp_ui(taken, 4) == 0;
+    check("取出后从文件删除", ok && pool.available(128) == 1 && wait_lines(path, 1));
+    ok = pool.take(128, p, q, taken) && !pool.take(128, p, q, taken);
+    check("取完后返回false", ok && wait_lines(path, 0));
+
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << pool_line(p, q) << pool_line(p, q) << pool_line(p, q);
+    }
+    pool.start(path, 2);
+    check("加载不超过容量", pool.available(128) == 2);
+
+    pool.reserve(192);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (pool.available(192) < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check("后台补充到容量为止", pool.available(192) == 2 && wait_lines(path, 4));
+
+    pool.reserve(4096);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto start = std::chrono::steady_clock::now();
+    pool.stop();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    check("stop中断4096位搜索", elapsed < 1000 && pool.available(4096) == 0);
+
+    mpz_clears(p, q, taken, NULL);
+    std::remove(path.c_str());
+}
+
+int main() {
+    test_sieve();
+    test_generate();
+    test_parallel();
+    test_concurrent();
+    test_bpsw();
+    test_certificate();
+    test_pool();
+
+    // 生成速度
+    mpz_t prime, q;
+    mpz_inits(prime, q, NULL);
+    std::cout << std::endl << "=== 生成速度 ===" << std::endl;
+    std::cout << "位数\tgetPrime\tgenSafePrime" << std::endl;
+    for (int bits : {256, 512, 1024}) {
+        auto start = std::chrono::high_resolution_clock::now();
+        getPrime(prime, bits);
+        auto mid = std::chrono::high_resolution_clock::now();
+        genSafePrime(prime, q, bits);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << bits << "\t" << std::chrono::duration_cast<std::chrono::milliseconds>(mid - start).count() << "ms\t\t"
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - mid).count() << "ms" << std::endl;
+    }
+    mpz_clears(prime, q, NULL);
+
+    std::cout << std::endl << (failures == 0 ? "全部通过" : "存在失败用例") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
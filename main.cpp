@@ -1,4 +1,5 @@
 #include "./frontend/web.hpp"
+#include "./getPrime/primePool.hpp"
 #include <iostream>
 #include <string>
 #include <memory>
@@ -7,6 +8,8 @@
 
 using namespace std;
 
+const char* PRIME_POOL_FILE = "safe_primes.pool"; // 素数池持久化文件
+
 atomic<bool> shutdown_requested(false);
 WebServer* global_webServer = nullptr;
 // 退出信号处理
@@ -23,16 +26,22 @@ void signalHandler(int signum) {
 }
 
 void printUsage(const string& programName) {
-    cout << "使用方法: " << programName << " [-p port] [-b bits]" << endl;
+    cout << "使用方法: " << programName << " [-p port] [-b bits | -g group] [-m mode] [--mac] [--pool n]" << endl;
     cout << "参数:" << endl;
     cout << "  -p port    指定前端服务器端口 (默认: 3000)" << endl;
     cout << "  -b bits    指定加密位数 (默认: 256)" << endl;
+    cout << "  -g group   使用标准安全素数群，不再生成素数: " << namedGroupList() << endl;
+    cout << "  -m mode    指定SM4工作模式 cbc/ctr/gcm (默认: cbc，双方需一致)" << endl;
+    cout << "  --mac      CBC模式下附加HMAC-SM3 (encrypt-then-MAC，双方需一致)" << endl;
+    cout << "  --pool n   后台预生成n组安全素数，保存在当前目录的 " << PRIME_POOL_FILE << " 中 (默认: 0，不使用)" << endl;
     cout << endl;
     cout << "示例:" << endl;
     cout << "  " << programName << "              # 使用默认端口3000，256位加密" << endl;
     cout << "  " << programName << " -p 8080      # 使用端口8080" << endl;
     cout << "  " << programName << " -b 512       # 使用512位加密" << endl;
     cout << "  " << programName << " -p 8080 -b 1024  # 使用端口8080和1024位加密" << endl;
+    cout << "  " << programName << " -m gcm       # 使用SM4-GCM认证加密模式" << endl;
+    cout << "  " << programName << " -g ffdhe2048 # 使用RFC 7919的2048位群" << endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -41,6 +50,10 @@ int main(int argc, char* argv[]) {
     
     int port = 3000;  // 默认端口
     int bits = 256;   // 默认加密位数
+    auto cipherMode = MessageEncryptor::CBC; // 默认SM4工作模式
+    bool encryptThenMac = false;
+    int poolSize = 0; // 素数池每个位数保留的组数，0表示不使用
+    const NamedGroup* group = nullptr; // 标准群，为空时每次握手生成新的安全素数
     
     for (int i = 1; i < argc; i++) {
         string arg = argv[i];
@@ -84,6 +97,58 @@ int main(int argc, char* argv[]) {
                 printUsage(argv[0]);
                 return 1;
             }
+        } else if (arg == "-g" || arg == "--group") {
+            if (i + 1 < argc) {
+                group = findNamedGroup(argv[i + 1]);
+                if (group == nullptr) {
+                    cerr << "错误: 未知的群 '" << argv[i + 1] << "'，可选: " << namedGroupList() << endl;
+                    return 1;
+                }
+                i++;
+            } else {
+                cerr << "错误: -g 参数需要指定群名称" << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "-m" || arg == "--mode") {
+            if (i + 1 < argc) {
+                string mode = argv[i + 1];
+                if (mode == "cbc") {
+                    cipherMode = MessageEncryptor::CBC;
+                } else if (mode == "ctr") {
+                    cipherMode = MessageEncryptor::CTR;
+                } else if (mode == "gcm") {
+                    cipherMode = MessageEncryptor::GCM;
+                } else {
+                    cerr << "错误: 无效的工作模式 '" << mode << "'" << endl;
+                    return 1;
+                }
+                i++;
+            } else {
+                cerr << "错误: -m 参数需要指定工作模式" << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--mac") {
+            encryptThenMac = true;
+        } else if (arg == "--pool") {
+            if (i + 1 < argc) {
+                try {
+                    poolSize = stoi(argv[i + 1]);
+                    if (poolSize < 0 || poolSize > 1024) {
+                        cerr << "错误: 素数池大小必须在0-1024之间" << endl;
+                        return 1;
+                    }
+                    i++;
+                } catch (const exception& e) {
+                    cerr << "错误: 无效的素数池大小 '" << argv[i + 1] << "'" << endl;
+                    return 1;
+                }
+            } else {
+                cerr << "错误: --pool 参数需要指定组数" << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
         } else {
             cerr << "错误: 未知参数 '" << arg << "'" << endl;
             printUsage(argv[0]);
@@ -91,15 +156,30 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (group != nullptr) {
+        bits = group->bits;  // 位数由群决定
+    }
+    
     cout << "=== End2End WebServer===" << endl;
     cout << "加密位数: " << bits << endl;
+    if (group != nullptr) {
+        cout << "素数群: " << group->name << endl;
+    }
+    const char* modeNames[] = {"CBC", "CTR", "GCM"};
+    cout << "工作模式: SM4-" << modeNames[cipherMode] << (encryptThenMac && cipherMode == MessageEncryptor::CBC ? " + HMAC-SM3" : "") << endl;
+    if (poolSize > 0 && group == nullptr) {
+        // 握手时直接取出预生成的素数，不必现场搜索
+        SafePrimePool::instance().reserve(bits);
+        SafePrimePool::instance().start(PRIME_POOL_FILE, poolSize);
+        cout << "素数池: " << SafePrimePool::instance().available(bits) << "/" << poolSize << " 组已就绪" << endl;
+    }
     cout << "按 Ctrl+C 退出" << endl;
     cout << "=========================" << endl;
     
     auto webServer = new WebServer(port);
     global_webServer = webServer; // 保存全局引用用于信号处理
     
-    auto core = make_shared<Core>(bits);
+    auto core = make_shared<Core>(bits, cipherMode, encryptThenMac, group);
     webServer->setCoreInstance(core);
     
     if (!webServer->start()) {
@@ -120,6 +200,7 @@ int main(int argc, char* argv[]) {
     
     cout << "\n正在关闭服务器..." << endl;
     webServer->stop();
+    SafePrimePool::instance().stop();
     cout << "服务器已关闭" << endl;
     
     delete webServer;
@@ -0,0 +1,212 @@
+#include "base64.hpp"
+#include <stdexcept>
+
+static const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 字符到6位数值的映射，非法字符(包括'=')为-1
+struct Base64DecodeTable
+{
+	int8_t v[256];
+	Base64DecodeTable()
+	{
+		for (int c = 0; c < 256; c++)
+		{
+			v[c] = -1;
+		}
+		for (int i = 0; i < 64; i++)
+		{
+			v[uint8_t(BASE64_CHARS[i])] = int8_t(i);
+		}
+	}
+};
+
+static const Base64DecodeTable BASE64_VALUES;
+
+static void base64_encode_scalar(const uint8_t* in, size_t len, char* out)
+{
+	size_t i = 0;
+	for (; i + 3 <= len; i += 3)
+	{
+		uint32_t x = uint32_t(in[i]) << 16 | uint32_t(in[i + 1]) << 8 | in[i + 2];
+		*out++ = BASE64_CHARS[x >> 18];
+		*out++ = BASE64_CHARS[(x >> 12) & 0x3F];
+		*out++ = BASE64_CHARS[(x >> 6) & 0x3F];
+		*out++ = BASE64_CHARS[x & 0x3F];
+	}
+	if (i < len)
+	{
+		uint32_t x = uint32_t(in[i]) << 16 | (i + 1 < len ? uint32_t(in[i + 1]) << 8 : 0);
+		*out++ = BASE64_CHARS[x >> 18];
+		*out++ = BASE64_CHARS[(x >> 12) & 0x3F];
+		*out++ = i + 1 < len ? BASE64_CHARS[(x >> 6) & 0x3F] : '=';
+		*out++ = '=';
+	}
+}
+
+// len为4的倍数；只有最后一组可以带1~2个'='
+static bool base64_decode_scalar(const char* in, size_t len, uint8_t* out, size_t& out_len)
+{
+	out_len = 0;
+	if (len == 0)
+	{
+		return true;
+	}
+	size_t pad = in[len - 1] == '=' ? (in[len - 2] == '=' ? 2 : 1) : 0;
+	int bad = 0;
+	size_t i = 0;
+	for (; i + 4 < len; i += 4)
+	{
+		int a = BASE64_VALUES.v[uint8_t(in[i])], b = BASE64_VALUES.v[uint8_t(in[i + 1])];
+		int c = BASE64_VALUES.v[uint8_t(in[i + 2])], d = BASE64_VALUES.v[uint8_t(in[i + 3])];
+		bad |= a | b | c | d;
+		uint32_t x = uint32_t(a) << 18 | uint32_t(b) << 12 | uint32_t(c) << 6 | uint32_t(d);
+		out[out_len++] = uint8_t(x >> 16);
+		out[out_len++] = uint8_t(x >> 8);
+		out[out_len++] = uint8_t(x);
+	}
+	// 最后一组: 填充处按'A'计算，其余位置不能是'='
+	int a = BASE64_VALUES.v[uint8_t(in[i])], b = BASE64_VALUES.v[uint8_t(in[i + 1])];
+	int c = pad == 2 ? 0 : BASE64_VALUES.v[uint8_t(in[i + 2])];
+	int d = pad >= 1 ? 0 : BASE64_VALUES.v[uint8_t(in[i + 3])];
+	bad |= a | b | c | d;
+	uint32_t x = uint32_t(a) << 18 | uint32_t(b) << 12 | uint32_t(c) << 6 | uint32_t(d);
+	out[out_len++] = uint8_t(x >> 16);
+	if (pad < 2)
+	{
+		out[out_len++] = uint8_t(x >> 8);
+	}
+	if (pad < 1)
+	{
+		out[out_len++] = uint8_t(x);
+	}
+	return bad >= 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define BASE64_AVX2 __attribute__((target("avx2")))
+
+// 编码: 每个128位通道取12字节，按3字节一组重排成 (b1 b0 b2 b1)，
+// 乘法移位拆出4个6位索引，再按索引区间查偏移表换成字符
+BASE64_AVX2 static void base64_encode_avx2(const uint8_t* in, size_t len, char* out)
+{
+	const __m256i shuf = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	// 索引经饱和减51并对0~25置13后: 13->'A'起，0->'a'起，1~10->'0'起，11->'+'，12->'/'
+	const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	size_t i = 0;
+	// 第二个通道从 i+12 读16字节，保证不越过输入末尾
+	for (; i + 28 <= len; i += 24)
+	{
+		__m256i x = _mm256_setr_m128i(_mm_loadu_si128((const __m128i*)(in + i)), _mm_loadu_si128((const __m128i*)(in + i + 12)));
+		x = _mm256_shuffle_epi8(x, shuf);
+		__m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(x, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+		__m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(x, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+		__m256i idx = _mm256_or_si256(t0, t1);
+		__m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+		r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+		r = _mm256_add_epi8(_mm256_shuffle_epi8(shift, r), idx);
+		_mm256_storeu_si256((__m256i*)(out + i / 3 * 4), r);
+	}
+	base64_encode_scalar(in + i, len - i, out + i / 3 * 4);
+}
+
+// 解码: 按高、低4位各查一张类别表，两者相与非0即为非法字符；
+// 再按高4位('/'单独处理)查偏移表得到6位数值，pmaddubsw/pmaddwd合并成3字节一组
+BASE64_AVX2 static bool base64_decode_avx2(const char* in, size_t len, uint8_t* out, size_t& out_len)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	__m256i invalid = _mm256_setzero_si256();
+	size_t i = 0, o = 0;
+	// 最后一组4个字符可能含'='，留给标量处理
+	for (; i + 32 + 4 <= len; i += 32, o += 24)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(in + i));
+		__m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(s, 4), mask_2f);
+		__m256i lo_nibbles = _mm256_and_si256(s, mask_2f);
+		__m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		invalid = _mm256_or_si256(invalid, _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), hi));
+		__m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(s, mask_2f), hi_nibbles));
+		__m256i v = _mm256_add_epi8(s, roll);
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm_storeu_si128((__m128i*)(out + o), _mm256_castsi256_si128(v));
+		_mm_storel_epi64((__m128i*)(out + o + 16), _mm256_extracti128_si256(v, 1));
+	}
+	size_t tail_len;
+	bool ok = base64_decode_scalar(in + i, len - i, out + o, tail_len);
+	out_len = o + tail_len;
+	return ok && _mm256_testz_si256(invalid, invalid);
+}
+
+#endif
+
+typedef void (*base64_encode_fn)(const uint8_t*, size_t, char*);
+typedef bool (*base64_decode_fn)(const char*, size_t, uint8_t*, size_t&);
+
+static base64_encode_fn select_base64_encode()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") ? base64_encode_avx2 : base64_encode_scalar;
+#else
+	return base64_encode_scalar;
+#endif
+}
+
+static base64_decode_fn select_base64_decode()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") ? base64_decode_avx2 : base64_decode_scalar;
+#else
+	return base64_decode_scalar;
+#endif
+}
+
+void base64_encode(const uint8_t* in, size_t len, char* out)
+{
+	static const base64_encode_fn impl = select_base64_encode();
+	impl(in, len, out);
+}
+
+bool base64_decode(const char* in, size_t len, uint8_t* out, size_t& out_len)
+{
+	out_len = 0;
+	if (len % 4 != 0)
+	{
+		return false;
+	}
+	static const base64_decode_fn impl = select_base64_decode();
+	return impl(in, len, out, out_len);
+}
+
+std::string base64_encode(const std::string& bytes)
+{
+	std::string text(base64_encoded_size(bytes.size()), '\0');
+	base64_encode(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), &text[0]);
+	return text;
+}
+
+std::string base64_decode(const std::string& text)
+{
+	std::string bytes(text.size() / 4 * 3, '\0');
+	size_t n = 0;
+	if (!base64_decode(text.data(), text.size(), reinterpret_cast<uint8_t*>(&bytes[0]), n))
+	{
+		throw std::invalid_argument("无效的Base64字符串");
+	}
+	bytes.resize(n);
+	return bytes;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Base64编解码(RFC 4648标准字母表，带'='填充): AVX2一次处理24字节/32字符，其余使用查表的标量实现
+
+/// @brief len字节编码后的字符数
+inline size_t base64_encoded_size(size_t len) { return (len + 2) / 3 * 4; }
+
+/// @brief 字节转Base64，out须有base64_encoded_size(len)字节
+void base64_encode(const uint8_t* in, size_t len, char* out);
+
+/// @brief Base64转字节，out须有len/4*3字节
+/// @param out_len 输出解码后的字节数
+/// @return 长度不是4的倍数、含非法字符或填充位置错误时返回false
+bool base64_decode(const char* in, size_t len, uint8_t* out, size_t& out_len);
+
+/// @brief 字节串转Base64字符串
+std::string base64_encode(const std::string& bytes);
+
+/// @brief Base64字符串转字节串，格式错误时抛出invalid_argument
+std::string base64_decode(const std::string& text);
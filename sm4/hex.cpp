@@ -0,0 +1,208 @@
+#include "hex.hpp"
+#include <stdexcept>
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// 字符到数值的映射，非HEX字符为-1
+struct HexDecodeTable
+{
+	int8_t v[256];
+	HexDecodeTable()
+	{
+		for (int c = 0; c < 256; c++)
+		{
+			v[c] = -1;
+		}
+		for (int i = 0; i < 10; i++)
+		{
+			v['0' + i] = int8_t(i);
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			v['A' + i] = v['a' + i] = int8_t(10 + i);
+		}
+	}
+};
+
+static const HexDecodeTable HEX_VALUES;
+
+static void hex_encode_scalar(const uint8_t* in, size_t len, char* out)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		out[2 * i] = HEX_DIGITS[in[i] >> 4];
+		out[2 * i + 1] = HEX_DIGITS[in[i] & 0x0F];
+	}
+}
+
+// 把出错与否累积到一个标志里，循环中不分支
+static bool hex_decode_scalar(const char* in, size_t len, uint8_t* out)
+{
+	int bad = 0;
+	for (size_t i = 0; i < len / 2; i++)
+	{
+		int hi = HEX_VALUES.v[uint8_t(in[2 * i])];
+		int lo = HEX_VALUES.v[uint8_t(in[2 * i + 1])];
+		bad |= hi | lo;
+		out[i] = uint8_t((hi << 4) | (lo & 0x0F));
+	}
+	return bad >= 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define HEX_SSSE3 __attribute__((target("ssse3")))
+#define HEX_AVX2 __attribute__((target("avx2")))
+
+// 高低4位拆开后交错: unpacklo/hi(高, 低) 得到 h0 l0 h1 l1 ...，再用pshufb查字符表
+HEX_SSSE3 static void hex_encode_ssse3(const uint8_t* in, size_t len, char* out)
+{
+	const __m128i digits = _mm_loadu_si128((const __m128i*)HEX_DIGITS);
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(x, mask));
+		_mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	hex_encode_scalar(in + i, len - i, out + 2 * i);
+}
+
+// unpack在128位通道内进行，结果的通道顺序为 (0-7, 16-23) 和 (8-15, 24-31)，用vperm2i128换回
+HEX_AVX2 static void hex_encode_avx2(const uint8_t* in, size_t len, char* out)
+{
+	const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)HEX_DIGITS));
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+		__m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+		__m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, mask));
+		__m256i a = _mm256_unpacklo_epi8(hi, lo);
+		__m256i b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i*)(out + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	hex_encode_ssse3(in + i, len - i, out + 2 * i);
+}
+
+// 16个字符转数值: '0'-'9' 和 'a'-'f'/'A'-'F'(或0x20统一为小写)，
+// 无符号范围判断用 min(x, n) == x；valid中非HEX字符的位置为0
+HEX_SSSE3 static inline __m128i hex_values_ssse3(__m128i c, __m128i& valid)
+{
+	__m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	__m128i a = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+	__m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a);
+	valid = _mm_and_si128(valid, _mm_or_si128(is_digit, is_alpha));
+	return _mm_or_si128(_mm_and_si128(is_digit, d), _mm_and_si128(is_alpha, _mm_add_epi8(a, _mm_set1_epi8(10))));
+}
+
+// 相邻两个数值合成一个字节: pmaddubsw 以 (16, 1) 为权重得到 16*hi + lo
+HEX_SSSE3 static bool hex_decode_ssse3(const char* in, size_t len, uint8_t* out)
+{
+	const __m128i weights = _mm_set1_epi16(0x0110);
+	__m128i valid = _mm_set1_epi8(-1);
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32)
+	{
+		__m128i v0 = hex_values_ssse3(_mm_loadu_si128((const __m128i*)(in + i)), valid);
+		__m128i v1 = hex_values_ssse3(_mm_loadu_si128((const __m128i*)(in + i + 16)), valid);
+		__m128i b = _mm_packus_epi16(_mm_maddubs_epi16(v0, weights), _mm_maddubs_epi16(v1, weights));
+		_mm_storeu_si128((__m128i*)(out + i / 2), b);
+	}
+	bool ok = _mm_movemask_epi8(valid) == 0xFFFF;
+	return hex_decode_scalar(in + i, len - i, out + i / 2) && ok;
+}
+
+HEX_AVX2 static inline __m256i hex_values_avx2(__m256i c, __m256i& valid)
+{
+	__m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+	__m256i a = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+	__m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+	__m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(a, _mm256_set1_epi8(5)), a);
+	valid = _mm256_and_si256(valid, _mm256_or_si256(is_digit, is_alpha));
+	return _mm256_or_si256(_mm256_and_si256(is_digit, d), _mm256_and_si256(is_alpha, _mm256_add_epi8(a, _mm256_set1_epi8(10))));
+}
+
+// packus在通道内进行，结果的64位段顺序为 0 2 1 3，用vpermq换回
+HEX_AVX2 static bool hex_decode_avx2(const char* in, size_t len, uint8_t* out)
+{
+	const __m256i weights = _mm256_set1_epi16(0x0110);
+	__m256i valid = _mm256_set1_epi8(-1);
+	size_t i = 0;
+	for (; i + 64 <= len; i += 64)
+	{
+		__m256i v0 = hex_values_avx2(_mm256_loadu_si256((const __m256i*)(in + i)), valid);
+		__m256i v1 = hex_values_avx2(_mm256_loadu_si256((const __m256i*)(in + i + 32)), valid);
+		__m256i b = _mm256_packus_epi16(_mm256_maddubs_epi16(v0, weights), _mm256_maddubs_epi16(v1, weights));
+		_mm256_storeu_si256((__m256i*)(out + i / 2), _mm256_permute4x64_epi64(b, 0xD8));
+	}
+	bool ok = _mm256_movemask_epi8(valid) == -1;
+	return hex_decode_ssse3(in + i, len - i, out + i / 2) && ok;
+}
+
+#endif
+
+typedef void (*hex_encode_fn)(const uint8_t*, size_t, char*);
+typedef bool (*hex_decode_fn)(const char*, size_t, uint8_t*);
+
+static hex_encode_fn select_hex_encode()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") ? hex_encode_avx2 : __builtin_cpu_supports("ssse3") ? hex_encode_ssse3 : hex_encode_scalar;
+#else
+	return hex_encode_scalar;
+#endif
+}
+
+static hex_decode_fn select_hex_decode()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") ? hex_decode_avx2 : __builtin_cpu_supports("ssse3") ? hex_decode_ssse3 : hex_decode_scalar;
+#else
+	return hex_decode_scalar;
+#endif
+}
+
+void hex_encode(const uint8_t* in, size_t len, char* out)
+{
+	static const hex_encode_fn impl = select_hex_encode();
+	impl(in, len, out);
+}
+
+bool hex_decode(const char* in, size_t len, uint8_t* out)
+{
+	if (len % 2 != 0)
+	{
+		return false;
+	}
+	static const hex_decode_fn impl = select_hex_decode();
+	return impl(in, len, out);
+}
+
+std::string hex_encode(const std::string& bytes)
+{
+	std::string hex(2 * bytes.size(), '\0');
+	hex_encode(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), &hex[0]);
+	return hex;
+}
+
+std::string hex_decode(const std::string& hex)
+{
+	if (hex.size() % 2 != 0)
+	{
+		throw std::invalid_argument("十六进制字符串长度必须为偶数");
+	}
+	std::string bytes(hex.size() / 2, '\0');
+	if (!hex_decode(hex.data(), hex.size(), reinterpret_cast<uint8_t*>(&bytes[0])))
+	{
+		throw std::invalid_argument("无效的十六进制字符");
+	}
+	return bytes;
+}
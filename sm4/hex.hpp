@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// HEX编解码: AVX2/SSSE3一次处理32/16字节，不支持的CPU使用查表的标量实现
+// 编码输出大写字母，解码大小写均可
+
+/// @brief 字节转HEX，out须有2*len字节
+void hex_encode(const uint8_t* in, size_t len, char* out);
+
+/// @brief HEX转字节，out须有len/2字节，可与in相同(原地解码)
+/// @return len为奇数或含非HEX字符时返回false，此时out内容未定义
+bool hex_decode(const char* in, size_t len, uint8_t* out);
+
+/// @brief 字节串转HEX字符串
+std::string hex_encode(const std::string& bytes);
+
+/// @brief HEX字符串转字节串，长度为奇数或含非HEX字符时抛出invalid_argument
+std::string hex_decode(const std::string& hex);
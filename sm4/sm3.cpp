@@ -0,0 +1,271 @@
+#include "sm3.hpp"
+#include "sm4_internal.hpp"
+#include <cstring>
+
+const uint32_t SM3_IV[8] = {
+	0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600, 0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
+};
+
+static inline uint32_t rotl(uint32_t x, int n)
+{
+	n &= 31;
+	return n == 0 ? x : (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t x)
+{
+	p[0] = uint8_t(x >> 24);
+	p[1] = uint8_t(x >> 16);
+	p[2] = uint8_t(x >> 8);
+	p[3] = uint8_t(x);
+}
+
+static inline uint32_t P0(uint32_t x)
+{
+	return x ^ rotl(x, 9) ^ rotl(x, 17);
+}
+
+static inline uint32_t P1(uint32_t x)
+{
+	return x ^ rotl(x, 15) ^ rotl(x, 23);
+}
+
+SM3RoundConstants::SM3RoundConstants()
+{
+	for (int j = 0; j < 64; j++)
+	{
+		t[j] = rotl(j < 16 ? 0x79CC4519 : 0x7A879D8A, j);
+	}
+}
+
+const SM3RoundConstants SM3_TJ;
+
+void sm3_compress(uint32_t state[8], const uint8_t* blocks, size_t nblocks)
+{
+	uint32_t W[68];
+	for (; nblocks > 0; nblocks--, blocks += SM3_BLOCK_SIZE)
+	{
+		// 消息扩展，W'j = Wj ^ Wj+4 在轮函数中现算
+		for (int j = 0; j < 16; j++)
+		{
+			W[j] = load_be32(blocks + 4 * j);
+		}
+		for (int j = 16; j < 68; j++)
+		{
+			W[j] = P1(W[j - 16] ^ W[j - 9] ^ rotl(W[j - 3], 15)) ^ rotl(W[j - 13], 7) ^ W[j - 6];
+		}
+
+		uint32_t A = state[0], B = state[1], C = state[2], D = state[3];
+		uint32_t E = state[4], F = state[5], G = state[6], H = state[7];
+		for (int j = 0; j < 64; j++)
+		{
+			uint32_t a12 = rotl(A, 12);
+			uint32_t SS1 = rotl(a12 + E + SM3_TJ.t[j], 7);
+			uint32_t SS2 = SS1 ^ a12;
+			uint32_t ff = j < 16 ? (A ^ B ^ C) : ((A & B) | (A & C) | (B & C));
+			uint32_t gg = j < 16 ? (E ^ F ^ G) : ((E & F) | (~E & G));
+			uint32_t TT1 = ff + D + SS2 + (W[j] ^ W[j + 4]);
+			uint32_t TT2 = gg + H + SS1 + W[j];
+			D = C;
+			C = rotl(B, 9);
+			B = A;
+			A = TT1;
+			H = G;
+			G = rotl(F, 19);
+			F = E;
+			E = P0(TT2);
+		}
+		state[0] ^= A;
+		state[1] ^= B;
+		state[2] ^= C;
+		state[3] ^= D;
+		state[4] ^= E;
+		state[5] ^= F;
+		state[6] ^= G;
+		state[7] ^= H;
+	}
+}
+
+void sm3_init(SM3Context& ctx)
+{
+	memcpy(ctx.state, SM3_IV, sizeof(SM3_IV));
+	ctx.buf_len = 0;
+	ctx.total_len = 0;
+}
+
+void sm3_update(SM3Context& ctx, const uint8_t* data, size_t len)
+{
+	if (len == 0)
+	{
+		return;
+	}
+	ctx.total_len += len;
+	if (ctx.buf_len > 0)
+	{
+		size_t take = SM3_BLOCK_SIZE - ctx.buf_len < len ? SM3_BLOCK_SIZE - ctx.buf_len : len;
+		memcpy(ctx.buf + ctx.buf_len, data, take);
+		ctx.buf_len += take;
+		data += take;
+		len -= take;
+		if (ctx.buf_len < SM3_BLOCK_SIZE)
+		{
+			return;
+		}
+		sm3_compress(ctx.state, ctx.buf, 1);
+		ctx.buf_len = 0;
+	}
+	// 整分组直接从输入压缩，不经过缓冲区
+	size_t nblocks = len / SM3_BLOCK_SIZE;
+	sm3_compress(ctx.state, data, nblocks);
+	data += nblocks * SM3_BLOCK_SIZE;
+	len -= nblocks * SM3_BLOCK_SIZE;
+	memcpy(ctx.buf, data, len);
+	ctx.buf_len = len;
+}
+
+void sm3_final(SM3Context& ctx, uint8_t digest[SM3_DIGEST_SIZE])
+{
+	// 填充: 1比特"1"，若干"0"，64比特消息长度
+	uint64_t bits = ctx.total_len * 8;
+	ctx.buf[ctx.buf_len++] = 0x80;
+	if (ctx.buf_len > SM3_BLOCK_SIZE - 8)
+	{
+		memset(ctx.buf + ctx.buf_len, 0, SM3_BLOCK_SIZE - ctx.buf_len);
+		sm3_compress(ctx.state, ctx.buf, 1);
+		ctx.buf_len = 0;
+	}
+	memset(ctx.buf + ctx.buf_len, 0, SM3_BLOCK_SIZE - 8 - ctx.buf_len);
+	store_be32(ctx.buf + 56, uint32_t(bits >> 32));
+	store_be32(ctx.buf + 60, uint32_t(bits));
+	sm3_compress(ctx.state, ctx.buf, 1);
+	for (int i = 0; i < 8; i++)
+	{
+		store_be32(digest + 4 * i, ctx.state[i]);
+	}
+}
+
+void sm3_hash(const uint8_t* data, size_t len, uint8_t digest[SM3_DIGEST_SIZE])
+{
+	SM3Context ctx;
+	sm3_init(ctx);
+	sm3_update(ctx, data, len);
+	sm3_final(ctx, digest);
+}
+
+// 从已压缩一个分组的链接变量继续
+static void sm3_resume(SM3Context& ctx, const uint32_t state[8])
+{
+	memcpy(ctx.state, state, sizeof(ctx.state));
+	ctx.buf_len = 0;
+	ctx.total_len = SM3_BLOCK_SIZE;
+}
+
+void hmac_sm3_set_key(HMACSM3Key& key, const uint8_t* raw_key, size_t key_len)
+{
+	uint8_t k[SM3_BLOCK_SIZE] = {0};
+	if (key_len > SM3_BLOCK_SIZE)
+	{
+		sm3_hash(raw_key, key_len, k);
+	}
+	else if (key_len > 0)
+	{
+		memcpy(k, raw_key, key_len);
+	}
+
+	uint8_t pad[SM3_BLOCK_SIZE];
+	for (size_t i = 0; i < SM3_BLOCK_SIZE; i++)
+	{
+		pad[i] = k[i] ^ 0x36;
+	}
+	memcpy(key.ipad_state, SM3_IV, sizeof(SM3_IV));
+	sm3_compress(key.ipad_state, pad, 1);
+	for (size_t i = 0; i < SM3_BLOCK_SIZE; i++)
+	{
+		pad[i] = k[i] ^ 0x5C;
+	}
+	memcpy(key.opad_state, SM3_IV, sizeof(SM3_IV));
+	sm3_compress(key.opad_state, pad, 1);
+	memset(k, 0, sizeof(k));
+	memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sm3_init(HMACSM3Context& ctx, const HMACSM3Key& key)
+{
+	ctx.key = &key;
+	sm3_resume(ctx.inner, key.ipad_state);
+}
+
+void hmac_sm3_update(HMACSM3Context& ctx, const uint8_t* data, size_t len)
+{
+	sm3_update(ctx.inner, data, len);
+}
+
+void hmac_sm3_final(HMACSM3Context& ctx, uint8_t mac[SM3_DIGEST_SIZE])
+{
+	uint8_t inner[SM3_DIGEST_SIZE];
+	sm3_final(ctx.inner, inner);
+	SM3Context outer;
+	sm3_resume(outer, ctx.key->opad_state);
+	sm3_update(outer, inner, SM3_DIGEST_SIZE);
+	sm3_final(outer, mac);
+}
+
+void hmac_sm3(const HMACSM3Key& key, const uint8_t* data, size_t len, uint8_t mac[SM3_DIGEST_SIZE])
+{
+	HMACSM3Context ctx;
+	hmac_sm3_init(ctx, key);
+	hmac_sm3_update(ctx, data, len);
+	hmac_sm3_final(ctx, mac);
+}
+
+void sm3_kdf_init(SM3KDF& kdf, const uint8_t* z, size_t z_len)
+{
+	sm3_init(kdf.base);
+	sm3_update(kdf.base, z, z_len);
+	kdf.counter = 1;
+	kdf.used = SM3_DIGEST_SIZE;
+}
+
+void sm3_kdf_next(SM3KDF& kdf, uint8_t* out, size_t len)
+{
+	while (len > 0)
+	{
+		if (kdf.used == SM3_DIGEST_SIZE)
+		{
+			uint8_t ct[4] = {uint8_t(kdf.counter >> 24), uint8_t(kdf.counter >> 16), uint8_t(kdf.counter >> 8), uint8_t(kdf.counter)};
+			SM3Context ctx = kdf.base;
+			sm3_update(ctx, ct, 4);
+			sm3_final(ctx, kdf.block);
+			kdf.counter++;
+			kdf.used = 0;
+		}
+		size_t n = SM3_DIGEST_SIZE - kdf.used < len ? SM3_DIGEST_SIZE - kdf.used : len;
+		memcpy(out, kdf.block + kdf.used, n);
+		kdf.used += n;
+		out += n;
+		len -= n;
+	}
+}
+
+void sm3_kdf(const uint8_t* z, size_t z_len, uint8_t* out, size_t klen)
+{
+	SM3KDF kdf;
+	sm3_kdf_init(kdf, z, z_len);
+	sm3_kdf_next(kdf, out, klen);
+	memset(&kdf, 0, sizeof(kdf));
+}
+
+bool hmac_sm3_verify(const uint8_t a[SM3_DIGEST_SIZE], const uint8_t b[SM3_DIGEST_SIZE])
+{
+	uint8_t diff = 0;
+	for (size_t i = 0; i < SM3_DIGEST_SIZE; i++)
+	{
+		diff |= a[i] ^ b[i];
+	}
+	return diff == 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+// SM3 原生实现: 以 uint32_t 字为单位的压缩函数和流式接口
+// sm34.h 中的 sm3(str, mode) 以此为后端
+
+const size_t SM3_DIGEST_SIZE = 32; // 杂凑值字节数
+const size_t SM3_BLOCK_SIZE = 64;  // 分组字节数
+
+/// @brief SM3流式计算上下文
+struct SM3Context {
+	uint32_t state[8];            // 链接变量V
+	uint8_t buf[SM3_BLOCK_SIZE]; // 未满一个分组的数据
+	size_t buf_len;
+	uint64_t total_len;           // 已输入的总字节数
+};
+
+/// @brief 压缩函数，依次处理nblocks个64字节分组
+/// @param state 链接变量，原地更新
+void sm3_compress(uint32_t state[8], const uint8_t* blocks, size_t nblocks);
+
+/// @brief 初始化上下文(V = IV)
+void sm3_init(SM3Context& ctx);
+
+/// @brief 输入数据，可多次调用
+void sm3_update(SM3Context& ctx, const uint8_t* data, size_t len);
+
+/// @brief 填充并输出32字节杂凑值，之后上下文需重新初始化才能再用
+void sm3_final(SM3Context& ctx, uint8_t digest[SM3_DIGEST_SIZE]);
+
+/// @brief 一次性计算杂凑值
+void sm3_hash(const uint8_t* data, size_t len, uint8_t digest[SM3_DIGEST_SIZE]);
+
+/// @brief HMAC-SM3密钥: 缓存 K^ipad 和 K^opad 压缩一个分组后的链接变量
+/// 设置一次密钥后，每次计算MAC只需压缩消息分组和一次外层分组
+struct HMACSM3Key {
+	uint32_t ipad_state[8];
+	uint32_t opad_state[8];
+};
+
+/// @brief HMAC-SM3流式计算上下文
+struct HMACSM3Context {
+	SM3Context inner;
+	const HMACSM3Key* key;
+};
+
+/// @brief 由原始密钥计算ipad/opad状态，超过64字节的密钥先做SM3
+void hmac_sm3_set_key(HMACSM3Key& key, const uint8_t* raw_key, size_t key_len);
+
+/// @brief 从缓存的ipad状态开始新的MAC计算(key须在计算结束前保持有效)
+void hmac_sm3_init(HMACSM3Context& ctx, const HMACSM3Key& key);
+
+void hmac_sm3_update(HMACSM3Context& ctx, const uint8_t* data, size_t len);
+
+/// @brief 输出32字节MAC
+void hmac_sm3_final(HMACSM3Context& ctx, uint8_t mac[SM3_DIGEST_SIZE]);
+
+/// @brief 一次性计算HMAC-SM3
+void hmac_sm3(const HMACSM3Key& key, const uint8_t* data, size_t len, uint8_t mac[SM3_DIGEST_SIZE]);
+
+/// @brief 常数时间比较两个MAC，相同返回true
+bool hmac_sm3_verify(const uint8_t a[SM3_DIGEST_SIZE], const uint8_t b[SM3_DIGEST_SIZE]);
+
+/// @brief GM/T 0003.4 密钥派生函数: K = SM3(Z || 1) || SM3(Z || 2) || ...(计数器为32位大端)
+/// 共享秘密Z只在初始化时吸收一次，之后每32字节输出只需复制缓存的上下文并压缩计数器所在分组。
+/// 输出按流的方式连续取出，多次调用sm3_kdf_next得到的字节与一次取出同样长度的结果相同。
+struct SM3KDF {
+	SM3Context base;                // 吸收Z之后的上下文
+	uint32_t counter;               // 下一个要使用的计数器值
+	uint8_t block[SM3_DIGEST_SIZE]; // 当前输出分组
+	size_t used;                    // block中已取出的字节数
+};
+
+/// @brief 吸收共享秘密Z，输出流从头开始
+void sm3_kdf_init(SM3KDF& kdf, const uint8_t* z, size_t z_len);
+
+/// @brief 从输出流中继续取出len字节
+void sm3_kdf_next(SM3KDF& kdf, uint8_t* out, size_t len);
+
+/// @brief 一次性派生klen字节
+void sm3_kdf(const uint8_t* z, size_t z_len, uint8_t* out, size_t klen);
+
+/// @brief 多缓冲SM3同时处理的消息数(AVX2的8个32位通道)
+const size_t SM3_MB_LANES = 8;
+
+/// @brief 多缓冲SM3任务
+struct SM3Job {
+	const uint8_t* data;             // 输入数据，任务完成前须保持有效
+	size_t len;
+	uint8_t digest[SM3_DIGEST_SIZE]; // 完成后写入的杂凑值
+	void* user_data;                 // 调用方自用，管理器不访问
+};
+
+/// @brief 多缓冲SM3任务管理器: 8条互相独立的消息在AVX2的8个通道中同时压缩
+/// 用法: 逐个submit，submit/flush返回已完成的任务(可能为nullptr)；
+/// 输入结束后反复调用flush直到返回nullptr。完成顺序不一定与提交顺序相同。
+/// 不支持AVX2的CPU上逐通道调用 sm3_compress，接口和结果不变。
+class SM3JobManager {
+public:
+	SM3JobManager();
+
+	/// @brief 提交任务，通道全部占满时压缩到至少一个任务完成
+	/// @return 一个已完成的任务，没有则返回nullptr
+	SM3Job* submit(SM3Job* job);
+
+	/// @brief 在空闲通道补空数据继续压缩，直到至少一个任务完成
+	/// @return 一个已完成的任务，全部完成后返回nullptr
+	SM3Job* flush();
+
+private:
+	struct Lane {
+		SM3Job* job;                      // nullptr表示空闲
+		const uint8_t* next;              // 下一个直接取自输入的整分组
+		size_t full_left;                 // 剩余整分组数
+		uint8_t tail[2 * SM3_BLOCK_SIZE]; // 末尾不足一组的数据及填充
+		size_t tail_blocks;
+		size_t tail_used;
+
+		size_t remaining() const { return full_left + tail_blocks - tail_used; }
+		const uint8_t* nextBlock();
+	};
+
+	void run();
+	SM3Job* flushCompleted(); // 取出一个已完成的任务
+
+	uint32_t state[8][SM3_MB_LANES]; // state[i][l]: 通道l的第i个链接变量字
+	Lane lanes[SM3_MB_LANES];
+	std::deque<SM3Job*> completed; // 已完成、尚未返回给调用方的任务
+};
@@ -1,13 +1,13 @@
 #include "sm34.h"
+#include "sm4.hpp"
+#include "hex.hpp"
+#include <vector>
+#include <stdexcept>
+#include <cctype>
 
 string Hex2string(string str)
 {
-	string res = "";
-	for (int i = 0; i < str.size(); i += 2)
-	{
-		res += char(HexToDec(str[i]) * 16 + HexToDec(str[i + 1]));
-	}
-	return res;
+	return hex_decode(str);
 }
 
 string DecToHex(int num)
@@ -222,145 +222,219 @@ string KeyExtension(string MK)
 	return rks;
 }
 
-string sm4_decode_ECB(string cipher, string key)
+// HEX字符串转字节，不足n字节的部分补0
+static void hex_to_bytes(const string& hex, uint8_t* out, size_t n)
 {
-	string res = "";
-	auto key__ = PKCS7_padding(key);
-	if (key__.size() > 32)
+	bool ok;
+	if (hex.size() >= 2 * n)
+	{
+		ok = hex_decode(hex.data(), 2 * n, out);
+	}
+	else
 	{
-		key__ = key__.substr(0, 32);
+		string padded = hex + string(2 * n - hex.size(), '0');
+		ok = hex_decode(padded.data(), 2 * n, out);
 	}
-	for (int i = 0; i < cipher.size(); i += 32)
+	if (!ok)
 	{
-		res += sm4_decode(cipher.substr(i, 32), key__);
+		throw invalid_argument("无效的十六进制字符");
 	}
-	return PKCS7_unpadding(res);
 }
 
-string sm4_decode_CBC(string cipher, string key, string IV)
+static string bytes_to_hex(const uint8_t* in, size_t n)
 {
-	string res = "";
-	auto key__ = PKCS7_padding(key);
-	string temp = IV;
-	if (key__.size() > 32)
+	string res(2 * n, '0');
+	hex_encode(in, n, &res[0]);
+	return res;
+}
+
+// 密钥标准化: PKCS7填充后截取前128位
+// 不足16字节时直接在输出上填充，不再生成填充后的HEX字符串
+static void load_key(const string& key, uint8_t out[16])
+{
+	if (key.size() % 2 != 0)
 	{
-		key__ = key__.substr(0, 32);
+		// 奇数位HEX的填充会错开半字节，保持原有算法
+		auto key__ = PKCS7_padding(key);
+		hex_to_bytes(key__.substr(0, 32), out, 16);
+		return;
 	}
-	if (temp.size() > 32)
+	size_t len = key.size() / 2;
+	if (len >= 16)
 	{
-		temp = temp.substr(0, 32);
+		hex_to_bytes(key, out, 16);
+		return;
 	}
-	for (int i = 0; i < cipher.size(); i += 32)
+	hex_to_bytes(key, out, len);
+	sm4_pkcs7_pad(out, len);
+}
+
+// HEX明文解码到buf并原地PKCS7填充，返回分组数
+static size_t load_padded(const string& plain, vector<uint8_t>& buf)
+{
+	if (plain.size() % 2 != 0)
 	{
-		res += XOR(sm4_decode(cipher.substr(i, 32), key__), temp);
-		temp = cipher.substr(i, 32);
+		throw invalid_argument("SM4 input length must be a multiple of 128 bits");
 	}
-	return PKCS7_unpadding(res);
+	size_t len = plain.size() / 2;
+	buf.resize(len / 16 * 16 + 16);
+	hex_to_bytes(plain, buf.data(), len);
+	return sm4_pkcs7_pad(buf.data(), len) / 16;
 }
 
-string String2Hex(string str)
+// 原地去除填充后转为HEX，填充不合法时抛出异常
+static string unpad_to_hex(const vector<uint8_t>& buf)
 {
-	string res = "";
-	for (int i = 0; i < str.size(); i++)
+	size_t len = 0;
+	if (!sm4_pkcs7_unpad(buf.data(), buf.size(), len))
 	{
-		res += DecToHex(int(str[i]));
+		throw invalid_argument("PKCS7填充无效");
 	}
-	return res;
+	return bytes_to_hex(buf.data(), len);
 }
 
-
-string Key_standardization(string key)
+static size_t block_count(const string& hex)
 {
-	return String2Hex(key);
+	if (hex.size() % 32 != 0)
+	{
+		throw invalid_argument("SM4 input length must be a multiple of 128 bits");
+	}
+	return hex.size() / 32;
 }
 
-string Plain_standardization(string plain)
+string sm4_encode(string plain, string key)
 {
-	return String2Hex(plain);
+	uint8_t k[16], block[16];
+	uint32_t rk[32];
+	hex_to_bytes(key, k, 16);
+	hex_to_bytes(plain, block, 16);
+	sm4_key_schedule(k, rk);
+	sm4_ecb_crypt(rk, block, block, 1);
+	return bytes_to_hex(block, 16);
 }
 
-string sm4_encode(string plain, string key)
+string sm4_decode(string cipher, string key)
 {
-	string cipher[36] = { plain.substr(0,8),plain.substr(8,8),plain.substr(16,8),plain.substr(24) };
-	string rks = KeyExtension(key);
-	for (int i = 0; i < 32; i++)
-	{
-		cipher[i + 4] = XOR(cipher[i], T(XOR(XOR(XOR(cipher[i + 1], cipher[i + 2]), cipher[i + 3]), rks.substr(8 * i, 8))));
-	}
-	return cipher[35] + cipher[34] + cipher[33] + cipher[32];
+	uint8_t k[16], block[16];
+	uint32_t rk[32];
+	hex_to_bytes(key, k, 16);
+	hex_to_bytes(cipher, block, 16);
+	sm4_key_schedule_dec(k, rk);
+	sm4_ecb_crypt(rk, block, block, 1);
+	return bytes_to_hex(block, 16);
 }
 
 string sm4_encode_ECB(string plain, string key)
 {
-	string res = "";
-	auto plain__ = PKCS7_padding(plain);
-	auto key__ = PKCS7_padding(key);
-	if (key__.size() > 32)
-	{
-		key__ = key__.substr(0, 32);
-	}
-	for (int i = 0; i < plain__.size(); i += 32)
-	{
-		res += sm4_encode(plain__.substr(i, 32), key__);
-	}
-	return res;
+	vector<uint8_t> buf;
+	size_t n = load_padded(plain, buf);
+	uint8_t k[16];
+	uint32_t rk[32];
+	load_key(key, k);
+	sm4_key_schedule(k, rk);
+
+	sm4_ecb_crypt(rk, buf.data(), buf.data(), n);
+	return bytes_to_hex(buf.data(), buf.size());
+}
+
+string sm4_decode_ECB(string cipher, string key)
+{
+	size_t n = block_count(cipher);
+	uint8_t k[16];
+	uint32_t rk[32];
+	load_key(key, k);
+	sm4_key_schedule_dec(k, rk);
+
+	vector<uint8_t> buf(16 * n);
+	hex_to_bytes(cipher, buf.data(), buf.size());
+	sm4_ecb_crypt(rk, buf.data(), buf.data(), n);
+	return unpad_to_hex(buf);
 }
 
 string sm4_encode_CBC_1(string plain, string key, string IV)
 {
-	string res = "";
-	for (int i = 0; i < plain.size(); i += 32)
-	{
-		res += sm4_encode(XOR(plain.substr(i, 32), IV), key);
-		IV = res.substr(i, 32);
-	}
-	return res;
+	size_t n = block_count(plain);
+	uint8_t k[16], iv[16];
+	uint32_t rk[32];
+	hex_to_bytes(key, k, 16);
+	hex_to_bytes(IV, iv, 16);
+	sm4_key_schedule(k, rk);
+
+	vector<uint8_t> buf(16 * n);
+	hex_to_bytes(plain, buf.data(), buf.size());
+	sm4_cbc_encrypt(rk, iv, buf.data(), buf.data(), n);
+	return bytes_to_hex(buf.data(), buf.size());
+}
+
+void sm4_set_key_hex(SM4Context& ctx, string key, string IV)
+{
+	uint8_t k[16], iv[16];
+	load_key(key, k);
+	hex_to_bytes(IV.substr(0, 32), iv, 16);
+	sm4_set_key(ctx, k, iv);
 }
 
 string sm4_encode_CBC(string plain, string key, string IV)
 {
-	string res = "";
-	auto plain__ = PKCS7_padding(plain);
-	auto key__ = PKCS7_padding(key);
-	string temp = IV;
-	if (temp.size() > 32)
-	{
-		temp = temp.substr(0, 32);
-	}
-	if (key__.size() > 32)
-	{
-		key__ = key__.substr(0, 32);
-	}
-	for (int i = 0; i < plain__.size(); i += 32)
-	{
-		temp = sm4_encode(XOR(plain__.substr(i, 32), temp), key__);
-		res += temp;
-	}
-	return res;
+	SM4Context ctx;
+	sm4_set_key_hex(ctx, key, IV);
+	return sm4_encode_CBC(plain, ctx);
+}
+
+string sm4_encode_CBC(string plain, const SM4Context& ctx)
+{
+	vector<uint8_t> buf;
+	size_t n = load_padded(plain, buf);
+	sm4_cbc_encrypt(ctx.rk_enc, ctx.iv, buf.data(), buf.data(), n);
+	return bytes_to_hex(buf.data(), buf.size());
 }
 
 //CBC模式解密算法(无填充)
 string sm4_decode_CBC_1(string cipher, string key, string IV)
 {
-	string res = "";
-	for (int i = 0; i < cipher.size(); i += 32)
-	{
-		res += XOR(sm4_decode(cipher.substr(i, 32), key), IV);
-		IV = cipher.substr(i, 32);
-	}
-	return res;
+	size_t n = block_count(cipher);
+	uint8_t k[16], iv[16];
+	uint32_t rk[32];
+	hex_to_bytes(key, k, 16);
+	hex_to_bytes(IV, iv, 16);
+	sm4_key_schedule_dec(k, rk);
+
+	vector<uint8_t> buf(16 * n);
+	hex_to_bytes(cipher, buf.data(), buf.size());
+	sm4_cbc_decrypt(rk, iv, buf.data(), buf.data(), n);
+	return bytes_to_hex(buf.data(), buf.size());
 }
 
+string sm4_decode_CBC(string cipher, string key, string IV)
+{
+	SM4Context ctx;
+	sm4_set_key_hex(ctx, key, IV);
+	return sm4_decode_CBC(cipher, ctx);
+}
 
-string sm4_decode(string cipher, string key)
+string sm4_decode_CBC(string cipher, const SM4Context& ctx)
 {
-	string plain[36] = { cipher.substr(0,8),cipher.substr(8,8), cipher.substr(16,8), cipher.substr(24,8) };
-	string rks = KeyExtension(key);
-	for (int i = 0; i < 32; i++)
-	{
-		plain[i + 4] = XOR(plain[i], T(XOR(XOR(XOR(plain[i + 1], plain[i + 2]), plain[i + 3]), rks.substr(8 * (31 - i), 8))));
-	}
-	return plain[35] + plain[34] + plain[33] + plain[32];
+	size_t n = block_count(cipher);
+	vector<uint8_t> buf(16 * n);
+	hex_to_bytes(cipher, buf.data(), buf.size());
+	sm4_cbc_decrypt(ctx.rk_dec, ctx.iv, buf.data(), buf.data(), n);
+	return unpad_to_hex(buf);
+}
+
+string String2Hex(string str)
+{
+	return hex_encode(str);
+}
+
+
+string Key_standardization(string key)
+{
+	return String2Hex(key);
+}
+
+string Plain_standardization(string plain)
+{
+	return String2Hex(plain);
 }
 
 //0为字符串，1为HEX
@@ -370,10 +444,7 @@ string padding(string str, int mode)
 
 	if (mode == 0)//字符串
 	{
-		for (int i = 0; i < str.size(); i++)
-		{//首先将输入值转换为16进制字符串
-			res += DecToHex((int)str[i]);
-		}
+		res = hex_encode(str);//首先将输入值转换为16进制字符串
 	}
 
 	else if (mode == 1)//HEX
@@ -436,12 +507,7 @@ string OR(string str1, string str2)
 
 string StringToHex(string str)
 {
-	string res = "";
-	for (int i = 0; i < str.size(); i++)
-	{
-		res += DecToHex((int)str[i]);
-	}
-	return res;
+	return hex_encode(str);
 }
 
 char binXor(char str1, char str2)
@@ -610,8 +676,21 @@ string iteration(string str)
 
 string sm3(string str, int mode)
 {
-	string res = padding(str, mode);
-	return iteration(res);
+	uint8_t digest[SM3_DIGEST_SIZE];
+	if (mode == 1)
+	{
+		if (str.size() % 2 != 0)
+		{
+			throw invalid_argument("SM3 hex input must have an even number of digits");
+		}
+		string data = hex_decode(str);
+		sm3_hash(reinterpret_cast<const uint8_t*>(data.data()), data.size(), digest);
+	}
+	else
+	{
+		sm3_hash(reinterpret_cast<const uint8_t*>(str.data()), str.size(), digest);
+	}
+	return bytes_to_hex(digest, SM3_DIGEST_SIZE);
 }
 
 string Gen_IV()
@@ -627,17 +706,17 @@ string Gen_IV()
 
 string PKCS7_padding(string hex_str)
 {
-	string res = "";
-	res = hex_str;
-	string str = Hex2string(hex_str);
-	int len = str.size();
-	int pad = 16 - (len % 16);
-	string pad_str = DecToHex(pad);
-	for (int i = 0; i < pad; i++)
+	size_t len = hex_str.size() / 2;
+	size_t pad = 16 - (len % 16);
+	char pad_hex[2];
+	uint8_t pad_byte = uint8_t(pad);
+	hex_encode(&pad_byte, 1, pad_hex);
+	hex_str.reserve(hex_str.size() + 2 * pad);
+	for (size_t i = 0; i < pad; i++)
 	{
-		res += pad_str;
+		hex_str.append(pad_hex, 2);
 	}
-	return res;
+	return hex_str;
 }
 
 string PKCS7_unpadding(string str)
@@ -3,6 +3,10 @@
 #include <string>
 #include <cmath>
 #include <iostream>
+#include "base64.hpp"
+#include "hex.hpp"
+#include "sm3.hpp"
+#include "sm4.hpp"
 
 using namespace std;
 
@@ -46,14 +50,32 @@ string sm4_decode_ECB(string cipher, string key); //ECB模式解密算法
 /// @return string
 string sm4_decode_CBC(string cipher, string key, string IV);//CBC模式解密算法
 
+/// @brief 由HEX密钥和IV建立密钥上下文，密钥标准化方式与sm4_encode_CBC相同
+/// @param ctx 
+/// @param key 
+/// @param IV 
+void sm4_set_key_hex(SM4Context& ctx, string key, string IV);
+
+/// @brief SM4_CBC加密算法(使用预先扩展的密钥上下文)
+/// @param plain HEX字符串
+/// @param ctx 
+/// @return HEX字符串
+string sm4_encode_CBC(string plain, const SM4Context& ctx);
+
+/// @brief SM4_CBC解密算法(使用预先扩展的密钥上下文)
+/// @param cipher HEX字符串
+/// @param ctx 
+/// @return HEX字符串
+string sm4_decode_CBC(string cipher, const SM4Context& ctx);
+
 /// @brief 字符串转十六进制(最多15字符，不足15个字符补0)
 /// @param str 
 /// @return 32位十六进制字符串
 string String2Hex(string str);//字符串转十六进制,补0
 
-/// @brief SM3算法
+/// @brief SM3算法(兼容接口，由 sm3_hash 计算)
 /// @param str 
-/// @param mode，0为字符串，1为HEX
+/// @param mode，0为字符串，1为HEX(位数须为偶数)
 /// @return 256位杂凑值(64位十六进制数)
 string sm3(string str, int mode);//sm3算法
 
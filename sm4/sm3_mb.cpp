@@ -0,0 +1,294 @@
+#include "sm3.hpp"
+#include "sm4_internal.hpp"
+#include <cstring>
+
+// 多缓冲SM3: 8条消息各占AVX2寄存器的一个32位通道，
+// 每次调用内核各压缩一个分组；消息长度不同时由任务管理器给空闲通道补空数据
+
+typedef void (*sm3_x8_fn)(uint32_t state[8][SM3_MB_LANES], const uint8_t* const blocks[SM3_MB_LANES]);
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t x)
+{
+	p[0] = uint8_t(x >> 24);
+	p[1] = uint8_t(x >> 16);
+	p[2] = uint8_t(x >> 8);
+	p[3] = uint8_t(x);
+}
+
+// 无AVX2时逐通道调用标量压缩函数
+static void sm3_compress_x8_scalar(uint32_t state[8][SM3_MB_LANES], const uint8_t* const blocks[SM3_MB_LANES])
+{
+	for (size_t l = 0; l < SM3_MB_LANES; l++)
+	{
+		uint32_t v[8];
+		for (int i = 0; i < 8; i++)
+		{
+			v[i] = state[i][l];
+		}
+		sm3_compress(v, blocks[l], 1);
+		for (int i = 0; i < 8; i++)
+		{
+			state[i][l] = v[i];
+		}
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SM3_AVX2 __attribute__((target("avx2")))
+
+SM3_AVX2 static inline __m256i rotl(__m256i x, int n)
+{
+	return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+SM3_AVX2 static inline __m256i xor3(__m256i a, __m256i b, __m256i c)
+{
+	return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+}
+
+SM3_AVX2 static inline __m256i P0(__m256i x)
+{
+	return xor3(x, rotl(x, 9), rotl(x, 17));
+}
+
+SM3_AVX2 static inline __m256i P1(__m256i x)
+{
+	return xor3(x, rotl(x, 15), rotl(x, 23));
+}
+
+// 8个通道各32字节 -> 8个字向量(第i个向量为各通道的第i个字)
+SM3_AVX2 static inline void load_transpose(const uint8_t* const blocks[SM3_MB_LANES], size_t offset, __m256i w[8])
+{
+	const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m256i r[8], t[8];
+	for (int l = 0; l < 8; l++)
+	{
+		r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(blocks[l] + offset)), bswap);
+	}
+	for (int l = 0; l < 8; l += 2)
+	{
+		t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+		t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+	}
+	for (int l = 0; l < 8; l += 4)
+	{
+		r[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+		r[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+		r[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+		r[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		w[i] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x20);
+		w[i + 4] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x31);
+	}
+}
+
+SM3_AVX2 static void sm3_compress_x8_avx2(uint32_t state[8][SM3_MB_LANES], const uint8_t* const blocks[SM3_MB_LANES])
+{
+	__m256i W[68];
+	load_transpose(blocks, 0, W);
+	load_transpose(blocks, 32, W + 8);
+	for (int j = 16; j < 68; j++)
+	{
+		W[j] = xor3(P1(xor3(W[j - 16], W[j - 9], rotl(W[j - 3], 15))), rotl(W[j - 13], 7), W[j - 6]);
+	}
+
+	__m256i A = _mm256_loadu_si256((const __m256i*)state[0]);
+	__m256i B = _mm256_loadu_si256((const __m256i*)state[1]);
+	__m256i C = _mm256_loadu_si256((const __m256i*)state[2]);
+	__m256i D = _mm256_loadu_si256((const __m256i*)state[3]);
+	__m256i E = _mm256_loadu_si256((const __m256i*)state[4]);
+	__m256i F = _mm256_loadu_si256((const __m256i*)state[5]);
+	__m256i G = _mm256_loadu_si256((const __m256i*)state[6]);
+	__m256i H = _mm256_loadu_si256((const __m256i*)state[7]);
+	for (int j = 0; j < 64; j++)
+	{
+		__m256i a12 = rotl(A, 12);
+		__m256i SS1 = rotl(_mm256_add_epi32(_mm256_add_epi32(a12, E), _mm256_set1_epi32(int(SM3_TJ.t[j]))), 7);
+		__m256i SS2 = _mm256_xor_si256(SS1, a12);
+		__m256i ff, gg;
+		if (j < 16)
+		{
+			ff = xor3(A, B, C);
+			gg = xor3(E, F, G);
+		}
+		else
+		{
+			ff = _mm256_or_si256(_mm256_and_si256(A, _mm256_or_si256(B, C)), _mm256_and_si256(B, C));
+			gg = _mm256_or_si256(_mm256_and_si256(E, F), _mm256_andnot_si256(E, G));
+		}
+		__m256i TT1 = _mm256_add_epi32(_mm256_add_epi32(ff, D), _mm256_add_epi32(SS2, _mm256_xor_si256(W[j], W[j + 4])));
+		__m256i TT2 = _mm256_add_epi32(_mm256_add_epi32(gg, H), _mm256_add_epi32(SS1, W[j]));
+		D = C;
+		C = rotl(B, 9);
+		B = A;
+		A = TT1;
+		H = G;
+		G = rotl(F, 19);
+		F = E;
+		E = P0(TT2);
+	}
+	_mm256_storeu_si256((__m256i*)state[0], _mm256_xor_si256(A, _mm256_loadu_si256((const __m256i*)state[0])));
+	_mm256_storeu_si256((__m256i*)state[1], _mm256_xor_si256(B, _mm256_loadu_si256((const __m256i*)state[1])));
+	_mm256_storeu_si256((__m256i*)state[2], _mm256_xor_si256(C, _mm256_loadu_si256((const __m256i*)state[2])));
+	_mm256_storeu_si256((__m256i*)state[3], _mm256_xor_si256(D, _mm256_loadu_si256((const __m256i*)state[3])));
+	_mm256_storeu_si256((__m256i*)state[4], _mm256_xor_si256(E, _mm256_loadu_si256((const __m256i*)state[4])));
+	_mm256_storeu_si256((__m256i*)state[5], _mm256_xor_si256(F, _mm256_loadu_si256((const __m256i*)state[5])));
+	_mm256_storeu_si256((__m256i*)state[6], _mm256_xor_si256(G, _mm256_loadu_si256((const __m256i*)state[6])));
+	_mm256_storeu_si256((__m256i*)state[7], _mm256_xor_si256(H, _mm256_loadu_si256((const __m256i*)state[7])));
+}
+
+static sm3_x8_fn select_x8()
+{
+	return sm4_cpu_has_avx2() ? sm3_compress_x8_avx2 : sm3_compress_x8_scalar;
+}
+
+#else
+
+static sm3_x8_fn select_x8()
+{
+	return sm3_compress_x8_scalar;
+}
+
+#endif
+
+static const sm3_x8_fn sm3_compress_x8 = select_x8();
+
+// 空闲通道的输入
+static const uint8_t ZERO_BLOCK[SM3_BLOCK_SIZE] = {0};
+
+const uint8_t* SM3JobManager::Lane::nextBlock()
+{
+	if (full_left > 0)
+	{
+		const uint8_t* p = next;
+		next += SM3_BLOCK_SIZE;
+		full_left--;
+		return p;
+	}
+	return tail + SM3_BLOCK_SIZE * tail_used++;
+}
+
+SM3JobManager::SM3JobManager()
+{
+	for (auto& lane : lanes)
+	{
+		lane.job = nullptr;
+	}
+}
+
+SM3Job* SM3JobManager::submit(SM3Job* job)
+{
+	size_t l = 0;
+	while (lanes[l].job != nullptr)
+	{
+		l++;
+	}
+	Lane& lane = lanes[l];
+	lane.job = job;
+	lane.next = job->data;
+	lane.full_left = job->len / SM3_BLOCK_SIZE;
+	lane.tail_used = 0;
+
+	// 预先填充末尾分组: 剩余数据 || 0x80 || 0... || 64比特长度
+	size_t rem = job->len % SM3_BLOCK_SIZE;
+	lane.tail_blocks = rem < SM3_BLOCK_SIZE - 8 ? 1 : 2;
+	size_t tail_len = SM3_BLOCK_SIZE * lane.tail_blocks;
+	memset(lane.tail, 0, tail_len);
+	if (rem > 0)
+	{
+		memcpy(lane.tail, job->data + job->len - rem, rem);
+	}
+	lane.tail[rem] = 0x80;
+	uint64_t bits = uint64_t(job->len) * 8;
+	store_be32(lane.tail + tail_len - 8, uint32_t(bits >> 32));
+	store_be32(lane.tail + tail_len - 4, uint32_t(bits));
+	for (int i = 0; i < 8; i++)
+	{
+		state[i][l] = SM3_IV[i];
+	}
+
+	bool full = true;
+	for (const auto& other : lanes)
+	{
+		full = full && other.job != nullptr;
+	}
+	if (full)
+	{
+		run();
+	}
+	return flushCompleted();
+}
+
+SM3Job* SM3JobManager::flush()
+{
+	if (completed.empty())
+	{
+		for (const auto& lane : lanes)
+		{
+			if (lane.job != nullptr)
+			{
+				run();
+				break;
+			}
+		}
+	}
+	return flushCompleted();
+}
+
+SM3Job* SM3JobManager::flushCompleted()
+{
+	if (completed.empty())
+	{
+		return nullptr;
+	}
+	SM3Job* job = completed.front();
+	completed.pop_front();
+	return job;
+}
+
+// 压缩到剩余分组最少的通道完成为止
+void SM3JobManager::run()
+{
+	size_t steps = SIZE_MAX;
+	for (const auto& lane : lanes)
+	{
+		if (lane.job != nullptr && lane.remaining() < steps)
+		{
+			steps = lane.remaining();
+		}
+	}
+
+	const uint8_t* blocks[SM3_MB_LANES];
+	for (size_t s = 0; s < steps; s++)
+	{
+		for (size_t l = 0; l < SM3_MB_LANES; l++)
+		{
+			blocks[l] = lanes[l].job != nullptr ? lanes[l].nextBlock() : ZERO_BLOCK;
+		}
+		sm3_compress_x8(state, blocks);
+	}
+
+	for (size_t l = 0; l < SM3_MB_LANES; l++)
+	{
+		Lane& lane = lanes[l];
+		if (lane.job != nullptr && lane.remaining() == 0)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				store_be32(lane.job->digest + 4 * i, state[i][l]);
+			}
+			completed.push_back(lane.job);
+			lane.job = nullptr;
+		}
+	}
+}
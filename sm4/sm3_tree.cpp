@@ -0,0 +1,73 @@
+#include "sm3_tree.hpp"
+#include "sm4_bulk.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+void sm3_tree_hash(const uint8_t* data, size_t len, uint8_t digest[SM3_DIGEST_SIZE], size_t leaf_size)
+{
+	sm3_tree_hash(SM4BulkEngine::instance(), data, len, digest, leaf_size);
+}
+
+void sm3_tree_hash(SM4BulkEngine& engine, const uint8_t* data, size_t len, uint8_t digest[SM3_DIGEST_SIZE], size_t leaf_size)
+{
+	if (leaf_size == 0 || leaf_size % SM3_BLOCK_SIZE != 0)
+	{
+		throw std::invalid_argument("叶子大小必须是64的正整数倍");
+	}
+
+	// 空输入视为一个空叶子
+	size_t nleaves = len == 0 ? 1 : (len + leaf_size - 1) / leaf_size;
+	std::vector<SM3Job> jobs(nleaves);
+	for (size_t i = 0; i < nleaves; i++)
+	{
+		size_t offset = i * leaf_size;
+		jobs[i].data = data + offset;
+		jobs[i].len = len - offset < leaf_size ? len - offset : leaf_size;
+	}
+
+	// 每个任务把连续的SM3_MB_LANES个叶子送入自己的多缓冲管理器
+	engine.parallelFor((nleaves + SM3_MB_LANES - 1) / SM3_MB_LANES, [&](size_t t) {
+		SM3JobManager mgr;
+		size_t end = (t + 1) * SM3_MB_LANES < nleaves ? (t + 1) * SM3_MB_LANES : nleaves;
+		for (size_t i = t * SM3_MB_LANES; i < end; i++)
+		{
+			mgr.submit(&jobs[i]);
+		}
+		while (mgr.flush() != nullptr)
+		{
+		}
+	});
+
+	std::vector<uint8_t> level(nleaves * SM3_DIGEST_SIZE);
+	for (size_t i = 0; i < nleaves; i++)
+	{
+		memcpy(level.data() + i * SM3_DIGEST_SIZE, jobs[i].digest, SM3_DIGEST_SIZE);
+	}
+
+	// 逐层合并，结果写回当前层的前半部分
+	uint8_t node[1 + 2 * SM3_DIGEST_SIZE];
+	node[0] = 0x01;
+	for (size_t n = nleaves; n > 1; n = (n + 1) / 2)
+	{
+		for (size_t i = 0; i < n / 2; i++)
+		{
+			memcpy(node + 1, level.data() + 2 * i * SM3_DIGEST_SIZE, 2 * SM3_DIGEST_SIZE);
+			sm3_hash(node, sizeof(node), level.data() + i * SM3_DIGEST_SIZE);
+		}
+		if (n % 2 == 1)
+		{
+			memmove(level.data() + n / 2 * SM3_DIGEST_SIZE, level.data() + (n - 1) * SM3_DIGEST_SIZE, SM3_DIGEST_SIZE);
+		}
+	}
+
+	uint8_t root[1 + 8 + 8 + SM3_DIGEST_SIZE];
+	root[0] = 0x02;
+	for (int i = 0; i < 8; i++)
+	{
+		root[1 + i] = uint8_t(uint64_t(len) >> (56 - 8 * i));
+		root[9 + i] = uint8_t(uint64_t(leaf_size) >> (56 - 8 * i));
+	}
+	memcpy(root + 17, level.data(), SM3_DIGEST_SIZE);
+	sm3_hash(root, sizeof(root), digest);
+}
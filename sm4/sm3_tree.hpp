@@ -0,0 +1,20 @@
+#pragma once
+#include "sm3.hpp"
+
+class SM4BulkEngine;
+
+// SM3树哈希: 输入按叶子大小切分，各叶子并行计算SM3，再两两合并成Merkle树
+//   叶子   H_i  = SM3(第i块数据)
+//   内部节点     = SM3(0x01 || 左 || 右)，某层节点数为奇数时最后一个直接升到上一层
+//   根          = SM3(0x02 || 64位大端总长度 || 64位大端叶子大小 || 顶层节点)
+// 结果只取决于数据和叶子大小，与线程数无关；与普通SM3的结果不同。
+
+/// @brief 默认叶子大小
+const size_t SM3_TREE_LEAF_SIZE = 1024 * 1024;
+
+/// @brief 使用进程内共享的线程池计算树哈希
+/// @param leaf_size 叶子大小，须为64的正整数倍
+void sm3_tree_hash(const uint8_t* data, size_t len, uint8_t digest[SM3_DIGEST_SIZE], size_t leaf_size = SM3_TREE_LEAF_SIZE);
+
+/// @brief 使用指定线程池计算树哈希
+void sm3_tree_hash(SM4BulkEngine& engine, const uint8_t* data, size_t len, uint8_t digest[SM3_DIGEST_SIZE], size_t leaf_size = SM3_TREE_LEAF_SIZE);
@@ -0,0 +1,113 @@
+#include "sm3_tree.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 计算文件的SM3树哈希(默认)或普通SM3，文件通过mmap映射后直接计算，不做额外拷贝
+
+void printUsage(const string& programName) {
+    cout << "使用方法: " << programName << " [-l leaf_kb] [--serial] file..." << endl;
+    cout << "参数:" << endl;
+    cout << "  -l leaf_kb  树哈希的叶子大小，单位KB (默认: " << SM3_TREE_LEAF_SIZE / 1024 << ")" << endl;
+    cout << "  --serial    计算普通SM3(单线程，与其他SM3工具结果一致)" << endl;
+}
+
+// 成功返回true，摘要写入digest
+bool hashFile(const string& path, bool serial, size_t leafSize, uint8_t digest[SM3_DIGEST_SIZE]) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "错误: 无法打开文件 '" << path << "'" << endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        cerr << "错误: '" << path << "' 不是普通文件" << endl;
+        close(fd);
+        return false;
+    }
+
+    size_t len = st.st_size;
+    const uint8_t* data = nullptr;
+    void* mapped = MAP_FAILED;
+    if (len > 0) { // 长度为0的文件不能映射
+        mapped = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            cerr << "错误: 无法映射文件 '" << path << "'" << endl;
+            close(fd);
+            return false;
+        }
+        madvise(mapped, len, serial ? MADV_SEQUENTIAL : MADV_WILLNEED);
+        data = static_cast<const uint8_t*>(mapped);
+    }
+
+    if (serial) {
+        sm3_hash(data, len, digest);
+    } else {
+        sm3_tree_hash(data, len, digest, leafSize);
+    }
+
+    if (mapped != MAP_FAILED) {
+        munmap(mapped, len);
+    }
+    close(fd);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool serial = false;
+    size_t leafSize = SM3_TREE_LEAF_SIZE;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--serial") {
+            serial = true;
+        } else if (arg == "-l" || arg == "--leaf") {
+            if (i + 1 >= argc) {
+                cerr << "错误: -l 参数需要指定叶子大小" << endl;
+                return 1;
+            }
+            try {
+                long kb = stol(argv[++i]);
+                if (kb <= 0) {
+                    throw invalid_argument("leaf");
+                }
+                leafSize = size_t(kb) * 1024;
+            } catch (const exception& e) {
+                cerr << "错误: 无效的叶子大小 '" << argv[i] << "'" << endl;
+                return 1;
+            }
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (const auto& path : files) {
+        uint8_t digest[SM3_DIGEST_SIZE];
+        if (!hashFile(path, serial, leafSize, digest)) {
+            status = 1;
+            continue;
+        }
+        for (uint8_t b : digest) {
+            cout << "0123456789abcdef"[b >> 4] << "0123456789abcdef"[b & 0x0F];
+        }
+        cout << "  " << path << endl;
+    }
+    return status;
+}
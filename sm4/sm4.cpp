@@ -0,0 +1,443 @@
+#include "sm4.hpp"
+#include "sm4_bulk.hpp"
+#include "sm4_internal.hpp"
+#include <atomic>
+#include <cstring>
+
+const uint8_t SM4_SBOX[256] = {
+	0xD6, 0x90, 0xE9, 0xFE, 0xCC, 0xE1, 0x3D, 0xB7, 0x16, 0xB6, 0x14, 0xC2, 0x28, 0xFB, 0x2C, 0x05,
+	0x2B, 0x67, 0x9A, 0x76, 0x2A, 0xBE, 0x04, 0xC3, 0xAA, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+	0x9C, 0x42, 0x50, 0xF4, 0x91, 0xEF, 0x98, 0x7A, 0x33, 0x54, 0x0B, 0x43, 0xED, 0xCF, 0xAC, 0x62,
+	0xE4, 0xB3, 0x1C, 0xA9, 0xC9, 0x08, 0xE8, 0x95, 0x80, 0xDF, 0x94, 0xFA, 0x75, 0x8F, 0x3F, 0xA6,
+	0x47, 0x07, 0xA7, 0xFC, 0xF3, 0x73, 0x17, 0xBA, 0x83, 0x59, 0x3C, 0x19, 0xE6, 0x85, 0x4F, 0xA8,
+	0x68, 0x6B, 0x81, 0xB2, 0x71, 0x64, 0xDA, 0x8B, 0xF8, 0xEB, 0x0F, 0x4B, 0x70, 0x56, 0x9D, 0x35,
+	0x1E, 0x24, 0x0E, 0x5E, 0x63, 0x58, 0xD1, 0xA2, 0x25, 0x22, 0x7C, 0x3B, 0x01, 0x21, 0x78, 0x87,
+	0xD4, 0x00, 0x46, 0x57, 0x9F, 0xD3, 0x27, 0x52, 0x4C, 0x36, 0x02, 0xE7, 0xA0, 0xC4, 0xC8, 0x9E,
+	0xEA, 0xBF, 0x8A, 0xD2, 0x40, 0xC7, 0x38, 0xB5, 0xA3, 0xF7, 0xF2, 0xCE, 0xF9, 0x61, 0x15, 0xA1,
+	0xE0, 0xAE, 0x5D, 0xA4, 0x9B, 0x34, 0x1A, 0x55, 0xAD, 0x93, 0x32, 0x30, 0xF5, 0x8C, 0xB1, 0xE3,
+	0x1D, 0xF6, 0xE2, 0x2E, 0x82, 0x66, 0xCA, 0x60, 0xC0, 0x29, 0x23, 0xAB, 0x0D, 0x53, 0x4E, 0x6F,
+	0xD5, 0xDB, 0x37, 0x45, 0xDE, 0xFD, 0x8E, 0x2F, 0x03, 0xFF, 0x6A, 0x72, 0x6D, 0x6C, 0x5B, 0x51,
+	0x8D, 0x1B, 0xAF, 0x92, 0xBB, 0xDD, 0xBC, 0x7F, 0x11, 0xD9, 0x5C, 0x41, 0x1F, 0x10, 0x5A, 0xD8,
+	0x0A, 0xC1, 0x31, 0x88, 0xA5, 0xCD, 0x7B, 0xBD, 0x2D, 0x74, 0xD0, 0x12, 0xB8, 0xE5, 0xB4, 0xB0,
+	0x89, 0x69, 0x97, 0x4A, 0x0C, 0x96, 0x77, 0x7E, 0x65, 0xB9, 0xF1, 0x09, 0xC5, 0x6E, 0xC6, 0x84,
+	0x18, 0xF0, 0x7D, 0xEC, 0x3A, 0xDC, 0x4D, 0x20, 0x79, 0xEE, 0x5F, 0x3E, 0xD7, 0xCB, 0x39, 0x48
+};
+
+static const uint32_t FK[4] = { 0xA3B1BAC6, 0x56AA3350, 0x677D9197, 0xB27022DC };
+
+static const uint32_t CK[32] = {
+	0x00070E15, 0x1C232A31, 0x383F464D, 0x545B6269,
+	0x70777E85, 0x8C939AA1, 0xA8AFB6BD, 0xC4CBD2D9,
+	0xE0E7EEF5, 0xFC030A11, 0x181F262D, 0x343B4249,
+	0x50575E65, 0x6C737A81, 0x888F969D, 0xA4ABB2B9,
+	0xC0C7CED5, 0xDCE3EAF1, 0xF8FF060D, 0x141B2229,
+	0x30373E45, 0x4C535A61, 0x686F767D, 0x848B9299,
+	0xA0A7AEB5, 0xBCC3CAD1, 0xD8DFE6ED, 0xF4FB0209,
+	0x10171E25, 0x2C333A41, 0x484F565D, 0x646B7279
+};
+
+static inline uint32_t rotl(uint32_t x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t x)
+{
+	p[0] = uint8_t(x >> 24);
+	p[1] = uint8_t(x >> 16);
+	p[2] = uint8_t(x >> 8);
+	p[3] = uint8_t(x);
+}
+
+// 非线性变换tau
+static inline uint32_t tau(uint32_t x)
+{
+	return (uint32_t(SM4_SBOX[x >> 24]) << 24) | (uint32_t(SM4_SBOX[(x >> 16) & 0xFF]) << 16) |
+		(uint32_t(SM4_SBOX[(x >> 8) & 0xFF]) << 8) | uint32_t(SM4_SBOX[x & 0xFF]);
+}
+
+// 合成置换T = L(tau(.))
+static inline uint32_t T(uint32_t x)
+{
+	uint32_t b = tau(x);
+	return b ^ rotl(b, 2) ^ rotl(b, 10) ^ rotl(b, 18) ^ rotl(b, 24);
+}
+
+// 密钥扩展用的合成置换T' = L'(tau(.))
+static inline uint32_t T2(uint32_t x)
+{
+	uint32_t b = tau(x);
+	return b ^ rotl(b, 13) ^ rotl(b, 23);
+}
+
+void sm4_key_schedule(const uint8_t key[16], uint32_t rk[32])
+{
+	uint32_t K[4];
+	for (int i = 0; i < 4; i++)
+	{
+		K[i] = load_be32(key + 4 * i) ^ FK[i];
+	}
+	for (int i = 0; i < 32; i++)
+	{
+		uint32_t k = K[0] ^ T2(K[1] ^ K[2] ^ K[3] ^ CK[i]);
+		K[0] = K[1];
+		K[1] = K[2];
+		K[2] = K[3];
+		K[3] = k;
+		rk[i] = k;
+	}
+}
+
+void sm4_key_schedule_dec(const uint8_t key[16], uint32_t rk[32])
+{
+	uint32_t enc[32];
+	sm4_key_schedule(key, enc);
+	for (int i = 0; i < 32; i++)
+	{
+		rk[i] = enc[31 - i];
+	}
+}
+
+void sm4_set_key(SM4Context& ctx, const uint8_t key[16], const uint8_t iv[16])
+{
+	sm4_key_schedule(key, ctx.rk_enc);
+	for (int i = 0; i < 32; i++)
+	{
+		ctx.rk_dec[i] = ctx.rk_enc[31 - i];
+	}
+	memcpy(ctx.iv, iv, 16);
+}
+
+void sm4_crypt_block(const uint32_t rk[32], const uint8_t in[16], uint8_t out[16])
+{
+	uint32_t x0 = load_be32(in), x1 = load_be32(in + 4), x2 = load_be32(in + 8), x3 = load_be32(in + 12);
+	for (int i = 0; i < 32; i += 4)
+	{
+		x0 ^= T(x1 ^ x2 ^ x3 ^ rk[i]);
+		x1 ^= T(x2 ^ x3 ^ x0 ^ rk[i + 1]);
+		x2 ^= T(x3 ^ x0 ^ x1 ^ rk[i + 2]);
+		x3 ^= T(x0 ^ x1 ^ x2 ^ rk[i + 3]);
+	}
+	// 反序变换R
+	store_be32(out, x3);
+	store_be32(out + 4, x2);
+	store_be32(out + 8, x1);
+	store_be32(out + 12, x0);
+}
+
+void sm4_blocks_scalar(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	for (size_t i = 0; i < nblocks; i++)
+	{
+		sm4_crypt_block(rk, in + 16 * i, out + 16 * i);
+	}
+}
+
+static SM4Backend detect_backend()
+{
+	if (sm4_cpu_has_gfni())
+	{
+		return SM4_BACKEND_GFNI;
+	}
+	if (sm4_cpu_has_aesni())
+	{
+		return SM4_BACKEND_AESNI;
+	}
+	if (sm4_cpu_has_avx2())
+	{
+		return SM4_BACKEND_AVX2;
+	}
+	return SM4_BACKEND_SCALAR;
+}
+
+// 按 SM4Backend 的顺序排列
+static const SM4Kernel KERNELS[] = {
+	{ SM4_BACKEND_SCALAR, sm4_blocks_scalar, 64 },
+	{ SM4_BACKEND_AVX2, sm4_blocks_avx2, 64 },
+	{ SM4_BACKEND_AESNI, sm4_blocks_aesni, 64 },
+	{ SM4_BACKEND_GFNI, sm4_blocks_gfni, 64 },
+	{ SM4_BACKEND_BITSLICE, sm4_blocks_bitslice, SM4_BITSLICE_BATCH },
+};
+
+// 启动时按CPUID选择一次多分组内核；切换时只替换指针，SM4BulkEngine的工作线程可同时读取
+static std::atomic<const SM4Kernel*> current_kernel(&KERNELS[detect_backend()]);
+
+const SM4Kernel& sm4_kernel()
+{
+	return *current_kernel.load(std::memory_order_acquire);
+}
+
+bool sm4_backend_supported(SM4Backend backend)
+{
+	switch (backend)
+	{
+	case SM4_BACKEND_SCALAR:
+	case SM4_BACKEND_BITSLICE:
+		return true;
+	case SM4_BACKEND_AVX2:
+		return sm4_cpu_has_avx2();
+	case SM4_BACKEND_AESNI:
+		return sm4_cpu_has_aesni();
+	case SM4_BACKEND_GFNI:
+		return sm4_cpu_has_gfni();
+	default:
+		return false;
+	}
+}
+
+bool sm4_set_backend(SM4Backend backend)
+{
+	if (!sm4_backend_supported(backend))
+	{
+		return false;
+	}
+	current_kernel.store(&KERNELS[backend], std::memory_order_release);
+	return true;
+}
+
+// 位切片内核一批256分组(AVX2)，大块数据上比AVX2/AES-NI的8分组内核快约一倍且同样是常数时间；
+// 交给SM4BulkEngine分块的数据改用它，小块数据仍用当前内核(位切片补齐一批的开销太大)
+static const SM4Kernel& bulk_kernel(const SM4Kernel& kernel)
+{
+	if ((kernel.backend == SM4_BACKEND_AVX2 || kernel.backend == SM4_BACKEND_AESNI) && sm4_cpu_has_avx2())
+	{
+		return KERNELS[SM4_BACKEND_BITSLICE];
+	}
+	return kernel;
+}
+
+SM4Backend sm4_get_backend()
+{
+	return sm4_kernel().backend;
+}
+
+const char* sm4_backend_name(SM4Backend backend)
+{
+	switch (backend)
+	{
+	case SM4_BACKEND_SCALAR:
+		return "scalar";
+	case SM4_BACKEND_AVX2:
+		return "avx2";
+	case SM4_BACKEND_AESNI:
+		return "aesni";
+	case SM4_BACKEND_GFNI:
+		return "gfni";
+	case SM4_BACKEND_BITSLICE:
+		return "bitslice";
+	default:
+		return "unknown";
+	}
+}
+
+static void ecb_crypt(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	if (16 * nblocks >= SM4_BULK_THRESHOLD)
+	{
+		SM4BulkEngine::instance().ecb(rk, in, out, nblocks, bulk_kernel(kernel));
+		return;
+	}
+	kernel.blocks(rk, in, out, nblocks);
+}
+
+void sm4_ecb_crypt(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	ecb_crypt(sm4_kernel(), rk, in, out, nblocks);
+}
+
+void sm4_ecb_crypt_bitsliced(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	ecb_crypt(KERNELS[SM4_BACKEND_BITSLICE], rk, in, out, nblocks);
+}
+
+void sm4_cbc_encrypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	// 链式依赖只能逐块加密，仍走当前后端的内核(常数时间后端不回退到查表)
+	const SM4Kernel& kernel = sm4_kernel();
+	uint8_t chain[16];
+	memcpy(chain, iv, 16);
+	for (size_t i = 0; i < nblocks; i++)
+	{
+		for (int j = 0; j < 16; j++)
+		{
+			chain[j] ^= in[16 * i + j];
+		}
+		kernel.blocks(rk, chain, chain, 1);
+		memcpy(out + 16 * i, chain, 16);
+	}
+}
+
+void sm4_cbc_encrypt_multi(const uint32_t rk[32], const uint8_t* const ivs[], const uint8_t* const in[], uint8_t* const out[],
+	const size_t nblocks[], size_t count)
+{
+	const SM4Kernel& kernel = sm4_kernel();
+	uint8_t chain[16 * SM4_CBC_MAX_LANES], buf[16 * SM4_CBC_MAX_LANES];
+	size_t active[SM4_CBC_MAX_LANES];
+	for (size_t base = 0; base < count; base += SM4_CBC_MAX_LANES)
+	{
+		size_t lanes = count - base < SM4_CBC_MAX_LANES ? count - base : SM4_CBC_MAX_LANES;
+		size_t steps = 0;
+		for (size_t l = 0; l < lanes; l++)
+		{
+			memcpy(chain + 16 * l, ivs[base + l], 16);
+			steps = nblocks[base + l] > steps ? nblocks[base + l] : steps;
+		}
+		for (size_t t = 0; t < steps; t++)
+		{
+			// 收集尚未结束的消息的第t个分组，异或各自的链值
+			size_t k = 0;
+			for (size_t l = 0; l < lanes; l++)
+			{
+				if (t < nblocks[base + l])
+				{
+					const uint8_t* p = in[base + l] + 16 * t;
+					for (int j = 0; j < 16; j++)
+					{
+						buf[16 * k + j] = chain[16 * l + j] ^ p[j];
+					}
+					active[k++] = l;
+				}
+			}
+			kernel.blocks(rk, buf, buf, k);
+			for (size_t i = 0; i < k; i++)
+			{
+				size_t l = active[i];
+				memcpy(chain + 16 * l, buf + 16 * i, 16);
+				memcpy(out[base + l] + 16 * t, buf + 16 * i, 16);
+			}
+		}
+	}
+}
+
+void sm4_cbc_decrypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	const SM4Kernel& kernel = sm4_kernel();
+	if (16 * nblocks >= SM4_BULK_THRESHOLD)
+	{
+		SM4BulkEngine::instance().cbcDecrypt(rk, iv, in, out, nblocks, bulk_kernel(kernel));
+		return;
+	}
+	sm4_cbc_decrypt_segment(kernel, rk, iv, in, out, nblocks);
+}
+
+void sm4_cbc_decrypt_segment(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	// CBC解密各分组互不依赖: 先用多分组内核批量解密，再与前一密文分组异或
+	uint8_t chain[16], next[16], buf[16 * SM4_MAX_CHUNK];
+	memcpy(chain, iv, 16);
+	while (nblocks > 0)
+	{
+		size_t n = nblocks < kernel.chunk ? nblocks : kernel.chunk;
+		kernel.blocks(rk, in, buf, n);
+		memcpy(next, in + 16 * (n - 1), 16);
+		// 倒序异或，允许in与out相同(原地解密)
+		for (size_t i = n - 1; i > 0; i--)
+		{
+			for (int j = 0; j < 16; j++)
+			{
+				out[16 * i + j] = buf[16 * i + j] ^ in[16 * (i - 1) + j];
+			}
+		}
+		for (int j = 0; j < 16; j++)
+		{
+			out[j] = buf[j] ^ chain[j];
+		}
+		memcpy(chain, next, 16);
+		in += 16 * n;
+		out += 16 * n;
+		nblocks -= n;
+	}
+}
+
+// 128位大端计数器加n
+static void ctr_add(uint8_t ctr[16], uint64_t n)
+{
+	for (int i = 15; i >= 0 && n != 0; i--)
+	{
+		n += ctr[i];
+		ctr[i] = uint8_t(n);
+		n >>= 8;
+	}
+}
+
+void sm4_ctr_segment(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t iv[16], uint64_t first_block, const uint8_t* in, uint8_t* out, size_t len)
+{
+	uint8_t ctr[16], ks[16 * SM4_MAX_CHUNK];
+	memcpy(ctr, iv, 16);
+	ctr_add(ctr, first_block);
+	while (len > 0)
+	{
+		size_t bytes = len < 16 * kernel.chunk ? len : 16 * kernel.chunk;
+		size_t n = (bytes + 15) / 16;
+		for (size_t i = 0; i < n; i++)
+		{
+			memcpy(ks + 16 * i, ctr, 16);
+			ctr_add(ctr, 1);
+		}
+		kernel.blocks(rk, ks, ks, n);
+		for (size_t i = 0; i < bytes; i++)
+		{
+			out[i] = in[i] ^ ks[i];
+		}
+		in += bytes;
+		out += bytes;
+		len -= bytes;
+	}
+}
+
+static void ctr_crypt(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len)
+{
+	if (len >= SM4_BULK_THRESHOLD)
+	{
+		SM4BulkEngine::instance().ctr(rk, iv, in, out, len, bulk_kernel(kernel));
+		return;
+	}
+	sm4_ctr_segment(kernel, rk, iv, 0, in, out, len);
+}
+
+void sm4_ctr_crypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len)
+{
+	ctr_crypt(sm4_kernel(), rk, iv, in, out, len);
+}
+
+void sm4_ctr_crypt_bitsliced(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len)
+{
+	ctr_crypt(KERNELS[SM4_BACKEND_BITSLICE], rk, iv, in, out, len);
+}
+
+size_t sm4_pkcs7_pad(uint8_t* buf, size_t len)
+{
+	size_t pad = 16 - len % 16;
+	memset(buf + len, int(pad), pad);
+	return len + pad;
+}
+
+// a < b 时返回全1，否则返回0 (a、b < 2^31)
+static inline uint32_t ct_lt_mask(uint32_t a, uint32_t b)
+{
+	return 0u - ((a - b) >> 31);
+}
+
+bool sm4_pkcs7_unpad(const uint8_t* buf, size_t len, size_t& plain_len)
+{
+	if (len == 0 || len % 16 != 0)
+	{
+		return false;
+	}
+	// 固定检查最后16字节，位于填充范围内的字节须等于pad，全程不按数据分支
+	uint32_t pad = buf[len - 1];
+	uint32_t valid = ct_lt_mask(0, pad) & ct_lt_mask(pad, 17);
+	uint32_t diff = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		diff |= ct_lt_mask(i, pad) & (buf[len - 1 - i] ^ pad);
+	}
+	valid &= ~ct_lt_mask(0, diff);
+	plain_len = len - (pad & valid);
+	return valid != 0;
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// SM4 原生实现: 以 uint32_t 字和字节缓冲区为单位运算
+// sm34.h 中基于 HEX 字符串的接口均以此为后端
+
+/// @brief SM4密钥上下文，密钥扩展只在设置密钥时进行一次
+struct SM4Context {
+	uint32_t rk_enc[32]; // 加密轮密钥
+	uint32_t rk_dec[32]; // 解密轮密钥
+	uint8_t iv[16];      // CBC初始向量
+};
+
+/// @brief 设置密钥上下文
+/// @param ctx 
+/// @param key 128位密钥
+/// @param iv 16字节初始向量
+void sm4_set_key(SM4Context& ctx, const uint8_t key[16], const uint8_t iv[16]);
+
+/// @brief SM4密钥扩展(加密轮密钥)
+/// @param key 128位密钥
+/// @param rk 输出32个轮密钥
+void sm4_key_schedule(const uint8_t key[16], uint32_t rk[32]);
+
+/// @brief SM4密钥扩展(解密轮密钥，即加密轮密钥逆序)
+/// @param key 128位密钥
+/// @param rk 输出32个轮密钥
+void sm4_key_schedule_dec(const uint8_t key[16], uint32_t rk[32]);
+
+/// @brief 单分组加解密，加密或解密取决于轮密钥的顺序
+/// 标量查表实现，运行时间与数据有关；需要常数时间时用 sm4_ecb_crypt 并选择常数时间后端
+/// @param rk 轮密钥
+/// @param in 16字节输入
+/// @param out 16字节输出，可与in相同
+void sm4_crypt_block(const uint32_t rk[32], const uint8_t in[16], uint8_t out[16]);
+
+/// @brief 多分组内核后端
+enum SM4Backend {
+	SM4_BACKEND_SCALAR, // 标量查表
+	SM4_BACKEND_AVX2,   // AVX2，8分组并行，S盒字节混洗查表
+	SM4_BACKEND_AESNI,  // AES-NI，S盒经仿射同构由AESENCLAST计算(常数时间)
+	SM4_BACKEND_GFNI,   // GFNI，S盒由GF(2^8)仿射/求逆指令计算(常数时间)
+	SM4_BACKEND_BITSLICE // 位切片，AVX2下256分组一批(常数时间，不依赖指令集；AVX2/AES-NI后端的大块数据自动改用它)
+};
+
+/// @brief 当前CPU是否支持该后端
+bool sm4_backend_supported(SM4Backend backend);
+
+/// @brief 切换后端(默认启动时按CPUID自动选择，主要用于测试和基准)
+/// 可在任意线程中调用；已经开始的运算(含多线程分块)继续使用原来的内核
+/// @return CPU不支持时返回false且不切换
+bool sm4_set_backend(SM4Backend backend);
+
+SM4Backend sm4_get_backend();
+const char* sm4_backend_name(SM4Backend backend);
+
+/// @brief 数据量达到该字节数时，ECB/CTR/CBC解密交给 SM4BulkEngine 多线程处理
+const size_t SM4_BULK_THRESHOLD = 256 * 1024;
+
+/// @brief ECB模式加解密(无填充)，走多分组内核
+/// @param nblocks 分组数
+void sm4_ecb_crypt(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief CTR模式加解密(加密与解密相同，无需填充)
+/// 计数器为128位大端整数，从iv开始逐块加1；密钥流按多分组内核批量生成
+/// @param rk 加密轮密钥(解密同样使用加密轮密钥)
+/// @param iv 16字节初始计数器，每条消息必须使用不同的值
+/// @param len 字节数，不要求是16的倍数
+void sm4_ctr_crypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len);
+
+/// @brief GCM模式IV的推荐长度(字节)
+const size_t SM4_GCM_IV_SIZE = 12;
+
+/// @brief GCM模式认证标签长度(字节)
+const size_t SM4_GCM_TAG_SIZE = 16;
+
+/// @brief GCM模式认证加密，CTR加密与GHASH在同一遍中完成
+/// @param rk 加密轮密钥
+/// @param iv 初始向量，推荐12字节，同一密钥下不得重复
+/// @param iv_len IV字节数，为0时抛出 std::invalid_argument
+/// @param aad 只认证不加密的附加数据，可为空
+/// @param len 明文字节数，不要求是16的倍数
+/// @param tag 输出16字节认证标签
+void sm4_gcm_encrypt(const uint32_t rk[32], const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+	const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[SM4_GCM_TAG_SIZE]);
+
+/// @brief GCM模式认证解密
+/// @param rk 加密轮密钥(解密同样使用加密轮密钥)
+/// @param iv_len IV字节数，为0时抛出 std::invalid_argument
+/// @param tag 待验证的16字节认证标签
+/// @return 标签正确返回true；错误返回false，此时out被清零
+bool sm4_gcm_decrypt(const uint32_t rk[32], const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+	const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[SM4_GCM_TAG_SIZE]);
+
+/// @brief 位切片ECB加解密，不论当前后端如何都保证常数时间
+/// 面向文件、历史记录等大块数据: 达到 SM4_BULK_THRESHOLD 时由 SM4BulkEngine 多线程处理
+/// @param nblocks 分组数，不足一批的尾部补齐后计算
+void sm4_ecb_crypt_bitsliced(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief 位切片CTR加解密，计数器与输出同 sm4_ctr_crypt，不论当前后端如何都保证常数时间
+void sm4_ctr_crypt_bitsliced(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len);
+
+/// @brief CBC模式加密(无填充)
+/// @param rk 加密轮密钥
+/// @param iv 16字节初始向量
+/// @param nblocks 分组数
+void sm4_cbc_encrypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief 批量CBC加密时同时推进的最大消息数(与多分组内核一次处理的分组数一致)
+const size_t SM4_CBC_MAX_LANES = 8;
+
+/// @brief 多条消息的CBC加密(无填充)
+/// 各消息的链互相独立，每一步取各消息的下一个分组一起送入多分组内核；
+/// 每条消息的输出与单独调用 sm4_cbc_encrypt 逐字节相同
+/// @param ivs 各消息的16字节初始向量
+/// @param in 各消息的输入，可与对应的out相同(原地加密)
+/// @param nblocks 各消息的分组数，可以各不相同
+/// @param count 消息条数，超过 SM4_CBC_MAX_LANES 时分批处理
+void sm4_cbc_encrypt_multi(const uint32_t rk[32], const uint8_t* const ivs[], const uint8_t* const in[], uint8_t* const out[],
+	const size_t nblocks[], size_t count);
+
+/// @brief CBC模式解密(无填充)，走多分组内核，支持原地解密
+/// @param rk 解密轮密钥
+/// @param iv 16字节初始向量
+/// @param nblocks 分组数
+void sm4_cbc_decrypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief 原地PKCS7填充: 在buf[len, 返回值)写入填充字节
+/// @param buf 须有 len / 16 * 16 + 16 字节
+/// @return 填充后的长度(16的倍数，至少比len多1)
+size_t sm4_pkcs7_pad(uint8_t* buf, size_t len);
+
+/// @brief 校验并去除PKCS7填充，耗时只与len有关，与填充内容无关
+/// @param len 16的正整数倍
+/// @param plain_len 输出明文长度，仅在返回true时有效
+/// @return 填充合法时返回true
+bool sm4_pkcs7_unpad(const uint8_t* buf, size_t len, size_t& plain_len);
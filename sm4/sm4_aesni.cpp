@@ -0,0 +1,226 @@
+#include "sm4_internal.hpp"
+#include "sm4.hpp"
+#include <cstring>
+
+// SM4 S盒与AES S盒仿射等价:
+//   S_sm4(x) = A2 * S_aes(A1 * x + c1) + c2
+// A1/A2 由两个有限域(SM4: x^8+x^7+x^6+x^5+x^4+x^2+1, AES: x^8+x^4+x^3+x+1)
+// 之间的同构以及两套S盒各自的仿射变换复合而成。
+// AES-NI 版本用 AESENCLAST 计算 S_aes，仿射变换用两次 pshufb 按半字节查表；
+// GFNI 版本直接用 gf2p8affine / gf2p8affineinv 完成仿射变换和求逆。
+// 以上常量由 SM4 S盒表逐项验证得到。
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SM4_SSSE3 __attribute__((target("ssse3")))
+#define SM4_AESNI __attribute__((target("ssse3,aes")))
+#define SM4_GFNI __attribute__((target("ssse3,gfni")))
+
+bool sm4_cpu_has_aesni()
+{
+	return __builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3");
+}
+
+bool sm4_cpu_has_gfni()
+{
+	return __builtin_cpu_supports("gfni") && __builtin_cpu_supports("ssse3");
+}
+
+// 半字节查表实现的仿射变换 y = lo[x & 0xF] ^ hi[x >> 4]
+SM4_SSSE3 static inline __m128i affine(__m128i x, __m128i lo, __m128i hi)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	__m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+	__m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi32(x, 4), mask));
+	return _mm_xor_si128(l, h);
+}
+
+SM4_AESNI static inline __m128i sbox_aesni(__m128i x)
+{
+	const __m128i pre_lo = _mm_setr_epi8(0x3E, 0xB2, 0x0E, 0x82, 0xBB, 0x37, 0x8B, 0x07, 0xA1, 0x2D, 0x91, 0x1D, 0x24, 0xA8, 0x14, 0x98);
+	const __m128i pre_hi = _mm_setr_epi8(0x00, 0xDC, 0x2E, 0xF2, 0xC5, 0x19, 0xEB, 0x37, 0x08, 0xD4, 0x26, 0xFA, 0xCD, 0x11, 0xE3, 0x3F);
+	const __m128i post_lo = _mm_setr_epi8(0x6C, 0xD4, 0xA6, 0x1E, 0x52, 0xEA, 0x98, 0x20, 0x0B, 0xB3, 0xC1, 0x79, 0x35, 0x8D, 0xFF, 0x47);
+	const __m128i post_hi = _mm_setr_epi8(0x00, 0xE0, 0x50, 0xB0, 0x9D, 0x7D, 0xCD, 0x2D, 0xC0, 0x20, 0x90, 0x70, 0x5D, 0xBD, 0x0D, 0xED);
+	// AESENCLAST = ShiftRows + SubBytes + 轮密钥异或，先做逆ShiftRows抵消字节换位
+	const __m128i inv_shift_rows = _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3);
+	x = affine(x, pre_lo, pre_hi);
+	x = _mm_aesenclast_si128(_mm_shuffle_epi8(x, inv_shift_rows), _mm_setzero_si128());
+	return affine(x, post_lo, post_hi);
+}
+
+SM4_GFNI static inline __m128i sbox_gfni(__m128i x)
+{
+	const __m128i pre = _mm_set1_epi64x(0x4C287DB91A22505DLL);
+	const __m128i post = _mm_set1_epi64x(int64_t(0xF3AB34A974A6B589ULL));
+	x = _mm_gf2p8affine_epi64_epi8(x, pre, 0x3E);
+	return _mm_gf2p8affineinv_epi64_epi8(x, post, 0xD3);
+}
+
+SM4_SSSE3 static inline __m128i rotl(__m128i x, int n)
+{
+	return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+// 线性变换L，L(B) = B ^ (B <<< 24) ^ ((B ^ (B <<< 8) ^ (B <<< 16)) <<< 2)
+SM4_SSSE3 static inline __m128i L(__m128i b)
+{
+	const __m128i rol8 = _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+	const __m128i rol16 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m128i rol24 = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+	__m128i t = _mm_xor_si128(b, _mm_xor_si128(_mm_shuffle_epi8(b, rol8), _mm_shuffle_epi8(b, rol16)));
+	return _mm_xor_si128(_mm_xor_si128(b, _mm_shuffle_epi8(b, rol24)), rotl(t, 2));
+}
+
+// 4个分组 <-> 4个字切片(寄存器i保存4个分组的第i个字)
+SM4_SSSE3 static inline void load4(const uint8_t* in, __m128i x[4])
+{
+	const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m128i b0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), bswap);
+	__m128i b1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16)), bswap);
+	__m128i b2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 32)), bswap);
+	__m128i b3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 48)), bswap);
+	__m128i t0 = _mm_unpacklo_epi32(b0, b1);
+	__m128i t1 = _mm_unpacklo_epi32(b2, b3);
+	__m128i t2 = _mm_unpackhi_epi32(b0, b1);
+	__m128i t3 = _mm_unpackhi_epi32(b2, b3);
+	x[0] = _mm_unpacklo_epi64(t0, t1);
+	x[1] = _mm_unpackhi_epi64(t0, t1);
+	x[2] = _mm_unpacklo_epi64(t2, t3);
+	x[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+// 含反序变换R
+SM4_SSSE3 static inline void store4(uint8_t* out, const __m128i x[4])
+{
+	const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m128i t0 = _mm_unpacklo_epi32(x[3], x[2]);
+	__m128i t1 = _mm_unpacklo_epi32(x[1], x[0]);
+	__m128i t2 = _mm_unpackhi_epi32(x[3], x[2]);
+	__m128i t3 = _mm_unpackhi_epi32(x[1], x[0]);
+	_mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(_mm_unpacklo_epi64(t0, t1), bswap));
+	_mm_storeu_si128((__m128i*)(out + 16), _mm_shuffle_epi8(_mm_unpackhi_epi64(t0, t1), bswap));
+	_mm_storeu_si128((__m128i*)(out + 32), _mm_shuffle_epi8(_mm_unpacklo_epi64(t2, t3), bswap));
+	_mm_storeu_si128((__m128i*)(out + 48), _mm_shuffle_epi8(_mm_unpackhi_epi64(t2, t3), bswap));
+}
+
+// 两组各4个分组交错执行，隐藏AESENCLAST/GF2P8AFFINE的延迟
+// x[j] ^= T(x[j+1] ^ x[j+2] ^ x[j+3] ^ rk)，下标按模4轮转
+#define SM4_ROUND4(SBOX, a, j, k) \
+	a[j] = _mm_xor_si128(a[j], L(SBOX(_mm_xor_si128(_mm_xor_si128(a[(j + 1) % 4], a[(j + 2) % 4]), _mm_xor_si128(a[(j + 3) % 4], k)))))
+
+#define SM4_ROUND8(SBOX, a, b, j, rk) \
+	do { \
+		__m128i k = _mm_set1_epi32(int(rk)); \
+		SM4_ROUND4(SBOX, a, j, k); \
+		SM4_ROUND4(SBOX, b, j, k); \
+	} while (0)
+
+#define SM4_CRYPT8(SBOX) \
+	__m128i a[4], b[4]; \
+	load4(in, a); \
+	load4(in + 64, b); \
+	for (int i = 0; i < 32; i += 4) \
+	{ \
+		SM4_ROUND8(SBOX, a, b, 0, rk[i]); \
+		SM4_ROUND8(SBOX, a, b, 1, rk[i + 1]); \
+		SM4_ROUND8(SBOX, a, b, 2, rk[i + 2]); \
+		SM4_ROUND8(SBOX, a, b, 3, rk[i + 3]); \
+	} \
+	store4(out, a); \
+	store4(out + 64, b)
+
+SM4_AESNI static void crypt8_aesni(const uint32_t rk[32], const uint8_t* in, uint8_t* out)
+{
+	SM4_CRYPT8(sbox_aesni);
+}
+
+SM4_GFNI static void crypt8_gfni(const uint32_t rk[32], const uint8_t* in, uint8_t* out)
+{
+	SM4_CRYPT8(sbox_gfni);
+}
+
+// 只有一组4个分组，用于CBC加密、GCM的H等1至4块的调用
+#define SM4_CRYPT4(SBOX) \
+	__m128i a[4]; \
+	load4(in, a); \
+	for (int i = 0; i < 32; i += 4) \
+	{ \
+		SM4_ROUND4(SBOX, a, 0, _mm_set1_epi32(int(rk[i]))); \
+		SM4_ROUND4(SBOX, a, 1, _mm_set1_epi32(int(rk[i + 1]))); \
+		SM4_ROUND4(SBOX, a, 2, _mm_set1_epi32(int(rk[i + 2]))); \
+		SM4_ROUND4(SBOX, a, 3, _mm_set1_epi32(int(rk[i + 3]))); \
+	} \
+	store4(out, a)
+
+SM4_AESNI static void crypt4_aesni(const uint32_t rk[32], const uint8_t* in, uint8_t* out)
+{
+	SM4_CRYPT4(sbox_aesni);
+}
+
+SM4_GFNI static void crypt4_gfni(const uint32_t rk[32], const uint8_t* in, uint8_t* out)
+{
+	SM4_CRYPT4(sbox_gfni);
+}
+
+typedef void (*crypt_fn)(const uint32_t*, const uint8_t*, uint8_t*);
+
+// 按8块一组处理，尾部补齐到4块或8块，单个分组也不回退到查表
+static void crypt_blocks(crypt_fn crypt8, crypt_fn crypt4, const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	while (nblocks >= 8)
+	{
+		crypt8(rk, in, out);
+		in += 128;
+		out += 128;
+		nblocks -= 8;
+	}
+	if (nblocks > 0)
+	{
+		uint8_t buf[128] = {0};
+		memcpy(buf, in, 16 * nblocks);
+		if (nblocks <= 4)
+		{
+			crypt4(rk, buf, buf);
+		}
+		else
+		{
+			crypt8(rk, buf, buf);
+		}
+		memcpy(out, buf, 16 * nblocks);
+	}
+}
+
+void sm4_blocks_aesni(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	crypt_blocks(crypt8_aesni, crypt4_aesni, rk, in, out, nblocks);
+}
+
+void sm4_blocks_gfni(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	crypt_blocks(crypt8_gfni, crypt4_gfni, rk, in, out, nblocks);
+}
+
+#else
+
+bool sm4_cpu_has_aesni()
+{
+	return false;
+}
+
+bool sm4_cpu_has_gfni()
+{
+	return false;
+}
+
+void sm4_blocks_aesni(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	sm4_blocks_scalar(rk, in, out, nblocks);
+}
+
+void sm4_blocks_gfni(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	sm4_blocks_scalar(rk, in, out, nblocks);
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "sm4_internal.hpp"
+#include "sm4.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SM4_AVX2 __attribute__((target("avx2")))
+
+bool sm4_cpu_has_avx2()
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+// 32字节S盒查表: 把256项S盒拆成16张16字节子表，按高4位选子表、低4位用vpshufb查表
+// idx = x ^ (h << 4)，仅当高4位等于h时 idx + 0x70 (饱和加) 不置最高位，
+// vpshufb 对最高位为1的索引输出0，因此16次查表结果直接异或即可
+SM4_AVX2 static inline __m256i sbox_lookup(__m256i x)
+{
+	const __m256i bias = _mm256_set1_epi8(0x70);
+	__m256i res = _mm256_setzero_si256();
+	for (int h = 0; h < 16; h++)
+	{
+		const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(SM4_SBOX + 16 * h)));
+		__m256i idx = _mm256_adds_epu8(_mm256_xor_si256(x, _mm256_set1_epi8(char(h << 4))), bias);
+		res = _mm256_xor_si256(res, _mm256_shuffle_epi8(table, idx));
+	}
+	return res;
+}
+
+SM4_AVX2 static inline __m256i rotl(__m256i x, int n)
+{
+	return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+// 合成置换T，L(B) = B ^ (B <<< 24) ^ ((B ^ (B <<< 8) ^ (B <<< 16)) <<< 2)
+SM4_AVX2 static inline __m256i T(__m256i x)
+{
+	const __m256i rol8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+		3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+	const __m256i rol16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m256i rol24 = _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+	__m256i b = sbox_lookup(x);
+	__m256i t = _mm256_xor_si256(b, _mm256_xor_si256(_mm256_shuffle_epi8(b, rol8), _mm256_shuffle_epi8(b, rol16)));
+	return _mm256_xor_si256(_mm256_xor_si256(b, _mm256_shuffle_epi8(b, rol24)), rotl(t, 2));
+}
+
+// 4x4 字转置(在每个128位通道内)，分组 <-> 字切片
+SM4_AVX2 static inline void transpose(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3)
+{
+	__m256i t0 = _mm256_unpacklo_epi32(x0, x1);
+	__m256i t1 = _mm256_unpacklo_epi32(x2, x3);
+	__m256i t2 = _mm256_unpackhi_epi32(x0, x1);
+	__m256i t3 = _mm256_unpackhi_epi32(x2, x3);
+	x0 = _mm256_unpacklo_epi64(t0, t1);
+	x1 = _mm256_unpackhi_epi64(t0, t1);
+	x2 = _mm256_unpacklo_epi64(t2, t3);
+	x3 = _mm256_unpackhi_epi64(t2, t3);
+}
+
+// 8个分组: 寄存器i保存第2i、2i+1个分组
+SM4_AVX2 static void crypt8(const uint32_t rk[32], const uint8_t* in, uint8_t* out)
+{
+	const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m256i x0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)in), bswap);
+	__m256i x1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + 32)), bswap);
+	__m256i x2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + 64)), bswap);
+	__m256i x3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + 96)), bswap);
+	transpose(x0, x1, x2, x3);
+
+	for (int i = 0; i < 32; i += 4)
+	{
+		x0 = _mm256_xor_si256(x0, T(_mm256_xor_si256(_mm256_xor_si256(x1, x2), _mm256_xor_si256(x3, _mm256_set1_epi32(int(rk[i]))))));
+		x1 = _mm256_xor_si256(x1, T(_mm256_xor_si256(_mm256_xor_si256(x2, x3), _mm256_xor_si256(x0, _mm256_set1_epi32(int(rk[i + 1]))))));
+		x2 = _mm256_xor_si256(x2, T(_mm256_xor_si256(_mm256_xor_si256(x3, x0), _mm256_xor_si256(x1, _mm256_set1_epi32(int(rk[i + 2]))))));
+		x3 = _mm256_xor_si256(x3, T(_mm256_xor_si256(_mm256_xor_si256(x0, x1), _mm256_xor_si256(x2, _mm256_set1_epi32(int(rk[i + 3]))))));
+	}
+
+	// 反序变换R
+	transpose(x3, x2, x1, x0);
+	_mm256_storeu_si256((__m256i*)out, _mm256_shuffle_epi8(x3, bswap));
+	_mm256_storeu_si256((__m256i*)(out + 32), _mm256_shuffle_epi8(x2, bswap));
+	_mm256_storeu_si256((__m256i*)(out + 64), _mm256_shuffle_epi8(x1, bswap));
+	_mm256_storeu_si256((__m256i*)(out + 96), _mm256_shuffle_epi8(x0, bswap));
+}
+
+SM4_AVX2 void sm4_blocks_avx2(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	while (nblocks >= 8)
+	{
+		crypt8(rk, in, out);
+		in += 128;
+		out += 128;
+		nblocks -= 8;
+	}
+	if (nblocks > 0)
+	{
+		// 尾部不足8块时补齐到8块再走向量路径，单个分组也不回退到查表
+		uint8_t buf[128] = {0};
+		memcpy(buf, in, 16 * nblocks);
+		crypt8(rk, buf, buf);
+		memcpy(out, buf, 16 * nblocks);
+	}
+}
+
+#else
+
+bool sm4_cpu_has_avx2()
+{
+	return false;
+}
+
+void sm4_blocks_avx2(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	sm4_blocks_scalar(rk, in, out, nblocks);
+}
+
+#endif
@@ -0,0 +1,399 @@
+#include "sm4_internal.hpp"
+#include "sm4.hpp"
+#include <cstring>
+
+// 位切片SM4: 每个向量保存一批分组的同一比特，全程只有与/异或运算，
+// 没有依赖数据的查表和分支，运行时间与明文和密钥无关。
+// 一批的分组数等于向量的位数: 支持AVX2时为256(ymm)，否则为128(x86-64上为SSE2，其他平台由编译器拆分)。
+//
+// S盒按代数结构计算: S(x) = POST * inv(PRE * x + PRE_C) + POST_C
+// 其中inv为GF(2^8)(模 x^8+x^7+x^6+x^5+x^4+x^2+1)上的求逆，在同构的复合域 GF(((2^2)^2)^2) 中进行:
+//   GF(4)   = GF(2)[w]/(w^2 + w + 1)
+//   GF(16)  = GF(4)[z]/(z^2 + z + w)
+//   GF(256) = GF(16)[y]/(y^2 + y + wz)
+// 复合域中的线性运算与PRE、POST两个矩阵合并后，用贪心公共子式消去得到下面的电路
+// (36个与门、130个异或门)，已对256个输入逐一验证。
+// PRE_C与POST_C不进电路: 前者折算进轮密钥，后者经L后每8轮抵消，见 KeyMasks。
+
+#define SM4_BS_INLINE inline __attribute__((always_inline))
+
+typedef uint64_t slice128 __attribute__((vector_size(16)));
+typedef uint64_t slice256 __attribute__((vector_size(32)));
+
+// 同构 * A，A * 同构^-1 (8x8 比特矩阵，第i个字节为输出比特i的行向量)，仅用于说明电路来源
+// PRE  = { 0x66, 0x65, 0xDB, 0xE3, 0x57, 0x40, 0x84, 0x7F }, PRE_C  = 0xED
+// POST = { 0xF5, 0x61, 0xC6, 0xF1, 0x7A, 0xDA, 0x13, 0x7F }, POST_C = 0xD3
+static constexpr uint32_t IN_C = 0x75757575;  // PRE^-1 * PRE_C，每字节一份
+static constexpr uint32_t OUT_C = 0xD3D3D3D3; // POST_C，每字节一份
+
+// x = POST * inv(PRE * x)，x[i]为字节的第i位
+template <typename V>
+SM4_BS_INLINE void sbox(V x[8])
+{
+	V t0 = x[3] ^ x[5];
+	V t1 = x[4] ^ t0;
+	V t2 = x[0] ^ t1;
+	V t3 = x[7] ^ t2;
+	V t4 = x[0] ^ x[1];
+	V t5 = x[4] ^ t4;
+	V t6 = t0 ^ t5;
+	V t7 = x[2] ^ t6;
+	V t8 = x[2] ^ x[7];
+	V t9 = x[1] ^ t8;
+	V t10 = t7 & t9;
+	V t11 = x[6] ^ t10;
+	V t12 = x[6] ^ x[7];
+	V t13 = t5 ^ t12;
+	V t14 = x[3] ^ t13;
+	V t15 = t8 & t14;
+	V t16 = x[2] ^ x[6];
+	V t17 = x[7] ^ t16;
+	V t18 = t0 ^ t17;
+	V t19 = t6 & t18;
+	V t20 = t19 ^ t0;
+	V t21 = t15 ^ t20;
+	V t22 = t16 ^ t6;
+	V t23 = t4 ^ t12;
+	V t24 = x[5] ^ t23;
+	V t25 = t22 & t24;
+	V t26 = x[0] ^ t25;
+	V t27 = t21 ^ t26;
+	V t28 = t11 ^ t27;
+	V t29 = t8 ^ t2;
+	V t30 = t29 & t13;
+	V t31 = t30 ^ t4;
+	V t32 = x[7] ^ t31;
+	V t33 = x[0] ^ x[5];
+	V t34 = t16 ^ t33;
+	V t35 = x[6] & t34;
+	V t36 = t16 ^ t5;
+	V t37 = x[1] ^ t16;
+	V t38 = x[5] ^ t37;
+	V t39 = t36 & t38;
+	V t40 = t35 ^ t39;
+	V t41 = t10 ^ t40;
+	V t42 = t32 ^ t41;
+	V t43 = x[5] ^ t15;
+	V t44 = t12 ^ t6;
+	V t45 = t1 & t44;
+	V t46 = t45 ^ t16;
+	V t47 = t43 ^ t46;
+	V t48 = t40 ^ t47;
+	V t49 = t42 & t48;
+	V t50 = x[1] ^ t25;
+	V t51 = t30 ^ t50;
+	V t52 = t49 ^ t51;
+	V t53 = x[3] ^ t19;
+	V t54 = t12 ^ t53;
+	V t55 = x[2] ^ t5;
+	V t56 = t4 & t55;
+	V t57 = t56 ^ t39;
+	V t58 = t31 ^ t57;
+	V t59 = t54 ^ t58;
+	V t60 = t57 ^ t26;
+	V t61 = t46 ^ t60;
+	V t62 = t59 & t61;
+	V t63 = t62 ^ t21;
+	V t64 = t12 ^ t40;
+	V t65 = t63 ^ t64;
+	V t66 = t52 ^ t65;
+	V t67 = t28 & t66;
+	V t68 = t10 ^ t45;
+	V t69 = t17 ^ t68;
+	V t70 = t69 ^ t43;
+	V t71 = t31 ^ t70;
+	V t72 = t56 ^ t35;
+	V t73 = t72 ^ t53;
+	V t74 = t11 ^ t73;
+	V t75 = t15 ^ t33;
+	V t76 = t25 ^ t72;
+	V t77 = t75 ^ t76;
+	V t78 = t74 & t77;
+	V t79 = t78 ^ t68;
+	V t80 = x[2] ^ t63;
+	V t81 = t57 ^ t80;
+	V t82 = t79 ^ t81;
+	V t83 = t71 & t82;
+	V t84 = t67 ^ t83;
+	V t85 = t74 & t66;
+	V t86 = t42 & t82;
+	V t87 = t85 ^ t86;
+	V t88 = t84 ^ t87;
+	V t89 = t3 & t88;
+	V t90 = t45 ^ t53;
+	V t91 = t8 ^ t51;
+	V t92 = t90 ^ t91;
+	V t93 = t78 ^ t69;
+	V t94 = t52 ^ t93;
+	V t95 = t72 ^ t94;
+	V t96 = t92 & t95;
+	V t97 = t67 ^ t96;
+	V t98 = t59 & t95;
+	V t99 = t85 ^ t98;
+	V t100 = t97 ^ t99;
+	V t101 = t18 & t100;
+	V t102 = t0 ^ t37;
+	V t103 = t98 ^ t86;
+	V t104 = t96 ^ t83;
+	V t105 = t103 ^ t104;
+	V t106 = t102 & t105;
+	V t107 = t23 & t99;
+	V t108 = t7 & t88;
+	V t109 = t107 ^ t108;
+	V t110 = t106 ^ t109;
+	V t111 = t101 ^ t110;
+	V t112 = t89 ^ t111;
+	V t113 = t22 & t87;
+	V t114 = x[3] ^ t36;
+	V t115 = t114 & t103;
+	V t116 = t8 & t103;
+	V t117 = t115 ^ t116;
+	V t118 = t113 ^ t117;
+	V t119 = t112 ^ t118;
+	V t120 = t44 & t99;
+	V t121 = x[2] ^ t33;
+	V t122 = t121 & t84;
+	V t123 = x[6] & t84;
+	V t124 = t122 ^ t123;
+	V t125 = t120 ^ t124;
+	V t126 = t115 ^ t125;
+	V t127 = t13 & t105;
+	V t128 = t55 & t97;
+	V t129 = t127 ^ t128;
+	V t130 = t113 ^ t129;
+	V t131 = x[4] ^ t33;
+	V t132 = t131 & t104;
+	V t133 = t132 ^ t109;
+	V t134 = t130 ^ t133;
+	V t135 = t126 ^ t134;
+	V t136 = x[3] ^ t8;
+	V t137 = x[4] ^ t136;
+	V t138 = t137 & t87;
+	V t139 = x[2] ^ x[4];
+	V t140 = t139 & t97;
+	V t141 = t138 ^ t140;
+	V t142 = t128 ^ t141;
+	V t143 = t124 ^ t142;
+	V t144 = t112 ^ t143;
+	V t145 = t122 ^ t118;
+	V t146 = t101 ^ t133;
+	V t147 = t145 ^ t146;
+	V t148 = t5 ^ t17;
+	V t149 = t148 & t100;
+	V t150 = t36 & t104;
+	V t151 = t138 ^ t150;
+	V t152 = t149 ^ t151;
+	V t153 = t130 ^ t152;
+	V t154 = t116 ^ t110;
+	V t155 = t153 ^ t154;
+	V t156 = t128 ^ t152;
+	V t157 = t120 ^ t116;
+	V t158 = t111 ^ t157;
+	V t159 = t156 ^ t158;
+	V t160 = t140 ^ t125;
+	V t161 = t117 ^ t160;
+	V t162 = t151 ^ t161;
+	V t163 = t108 ^ t117;
+	V t164 = t89 ^ t153;
+	V t165 = t163 ^ t164;
+	x[0] = t119;
+	x[1] = t135;
+	x[2] = t144;
+	x[3] = t147;
+	x[4] = t155;
+	x[5] = t159;
+	x[6] = t162;
+	x[7] = t165;
+}
+
+static inline uint32_t rotl32(uint32_t x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t L32(uint32_t b)
+{
+	return b ^ rotl32(b, 2) ^ rotl32(b, 10) ^ rotl32(b, 18) ^ rotl32(b, 24);
+}
+
+// 分组按小端读入，切片下标j为第j/8个字节的第j%8位，对应大端字的第 be_bit(j) 位
+// 字节内的位序不变，因此S盒直接作用于 j = 8k .. 8k+7；L的循环移位只是重新编号
+static constexpr int be_bit(int j)
+{
+	return (j & 7) | ((3 - (j >> 3)) << 3);
+}
+
+// 各轮密钥的每一位扩展为全0或全1的切片
+// 电路算的是 S(u ^ IN_C) ^ OUT_C: 第i轮的密钥补上IN_C；每轮少异或的 L(OUT_C) 累积在状态字上，
+// X[j] 比真实值多 c[j]，c[j + 4] = c[j] ^ L(OUT_C)，下一次作为输入时从密钥中扣除。
+// c[32..35] = 0，输出无需修正。
+template <typename V>
+struct KeyMasks
+{
+	V k[32][32];
+
+	SM4_BS_INLINE explicit KeyMasks(const uint32_t rk[32])
+	{
+		uint32_t c[36] = {0};
+		for (int j = 4; j < 36; j++)
+		{
+			c[j] = c[j - 4] ^ L32(OUT_C);
+		}
+		for (int i = 0; i < 32; i++)
+		{
+			uint32_t key = rk[i] ^ IN_C ^ c[i + 1] ^ c[i + 2] ^ c[i + 3];
+			for (int j = 0; j < 32; j++)
+			{
+				V zero = {};
+				k[i][j] = zero - uint64_t((key >> be_bit(j)) & 1);
+			}
+		}
+	}
+};
+
+// 64x64 比特矩阵转置，向量中每个64位通道各自独立: T[r] = a[r ^ flip]，T[r]的第c位 <-> T[c]的第r位
+template <typename V>
+SM4_BS_INLINE void transpose64(V* a, int flip)
+{
+	uint64_t m = 0x00000000FFFFFFFFULL;
+	for (int j = 32; j != 0; j >>= 1, m ^= m << j)
+	{
+		for (int k = 0; k < 64; k = ((k | j) + 1) & ~j)
+		{
+			V& lo = a[k ^ flip];
+			V& hi = a[(k | j) ^ flip];
+			V t = ((lo >> j) ^ hi) & m;
+			lo ^= t << j;
+			hi ^= t;
+		}
+	}
+}
+
+// 相邻两个向量(共K个分组)拆成各分组的前8字节和后8字节，通道顺序打乱但互为逆运算
+template <typename V>
+SM4_BS_INLINE void interleave(V a, V b, V& lo, V& hi)
+{
+	if constexpr (sizeof(V) == 32)
+	{
+		lo = __builtin_shuffle(a, b, V{ 0, 4, 2, 6 });
+		hi = __builtin_shuffle(a, b, V{ 1, 5, 3, 7 });
+	}
+	else
+	{
+		lo = __builtin_shuffle(a, b, V{ 0, 2 });
+		hi = __builtin_shuffle(a, b, V{ 1, 3 });
+	}
+}
+
+// 一批 8 * sizeof(V) 个分组
+template <typename V>
+SM4_BS_INLINE void crypt_batch(const KeyMasks<V>& km, const uint8_t* in, uint8_t* out)
+{
+	// X[32 * w + j]: 各分组第w个字的第j位
+	V X[128];
+	for (int r = 0; r < 64; r++)
+	{
+		V a, b;
+		memcpy(&a, in + 2 * sizeof(V) * r, sizeof(V));
+		memcpy(&b, in + 2 * sizeof(V) * r + sizeof(V), sizeof(V));
+		interleave(a, b, X[r], X[64 + r]);
+	}
+	transpose64(X, 0);
+	transpose64(X + 64, 0);
+
+	for (int i = 0; i < 32; i++)
+	{
+		V* x0 = X + 32 * (i % 4);
+		const V* x1 = X + 32 * ((i + 1) % 4);
+		const V* x2 = X + 32 * ((i + 2) % 4);
+		const V* x3 = X + 32 * ((i + 3) % 4);
+		const V* k = km.k[i];
+		V t[32];
+#pragma GCC unroll 4
+		for (int s = 0; s < 4; s++)
+		{
+			V b[8];
+#pragma GCC unroll 8
+			for (int j = 0; j < 8; j++)
+			{
+				b[j] = x1[8 * s + j] ^ x2[8 * s + j] ^ x3[8 * s + j] ^ k[8 * s + j];
+			}
+			sbox(b);
+#pragma GCC unroll 8
+			for (int j = 0; j < 8; j++)
+			{
+				t[8 * s + j] = b[j];
+			}
+		}
+		// L(B) = B ^ (B <<< 2) ^ (B <<< 10) ^ (B <<< 18) ^ (B <<< 24)
+#pragma GCC unroll 32
+		for (int j = 0; j < 32; j++)
+		{
+			int b = be_bit(j);
+			x0[j] ^= t[j] ^ t[be_bit((b + 30) % 32)] ^ t[be_bit((b + 22) % 32)] ^ t[be_bit((b + 14) % 32)] ^ t[be_bit((b + 8) % 32)];
+		}
+	}
+
+	// 反序变换R: 输出的4个字依次为第3、2、1、0个状态字，前8字节由第3、2个字转置回来
+	transpose64(X + 64, 32);
+	transpose64(X, 32);
+	for (int r = 0; r < 64; r++)
+	{
+		V a, b;
+		interleave(X[64 + (r ^ 32)], X[r ^ 32], a, b);
+		memcpy(out + 2 * sizeof(V) * r, &a, sizeof(V));
+		memcpy(out + 2 * sizeof(V) * r + sizeof(V), &b, sizeof(V));
+	}
+}
+
+template <typename V>
+SM4_BS_INLINE void crypt_blocks(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	const size_t batch = 8 * sizeof(V);
+	KeyMasks<V> km(rk);
+	for (; nblocks >= batch; nblocks -= batch)
+	{
+		crypt_batch(km, in, out);
+		in += 16 * batch;
+		out += 16 * batch;
+	}
+	if (nblocks > 0)
+	{
+		// 尾部同样补齐到一批，保持常数时间
+		uint8_t buf[16 * batch] = {0};
+		memcpy(buf, in, 16 * nblocks);
+		crypt_batch(km, buf, buf);
+		memcpy(out, buf, 16 * nblocks);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 256分组一批；不超过128块的尾部改用128位切片，少算一半
+__attribute__((target("avx2"))) static void crypt_blocks_avx2(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+	size_t tail = nblocks % 256;
+	if (tail != 0 && tail <= 128)
+	{
+		nblocks -= tail;
+		crypt_blocks<slice128>(rk, in + 16 * nblocks, out + 16 * nblocks, tail);
+	}
+	if (nblocks > 0)
+	{
+		crypt_blocks<slice256>(rk, in, out, nblocks);
+	}
+}
+
+#endif
+
+void sm4_blocks_bitslice(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (sm4_cpu_has_avx2())
+	{
+		crypt_blocks_avx2(rk, in, out, nblocks);
+		return;
+	}
+#endif
+	crypt_blocks<slice128>(rk, in, out, nblocks);
+}
@@ -0,0 +1,125 @@
+#include "sm4_bulk.hpp"
+#include "sm4.hpp"
+#include "sm4_internal.hpp"
+#include <cstring>
+#include <future>
+#include <memory>
+
+const size_t SM4BulkEngine::CHUNK_SIZE;
+
+SM4BulkEngine& SM4BulkEngine::instance()
+{
+	static SM4BulkEngine engine(std::thread::hardware_concurrency());
+	return engine;
+}
+
+SM4BulkEngine::SM4BulkEngine(size_t nthreads) : stopping(false)
+{
+	for (size_t i = 1; i < nthreads; i++)
+	{
+		workers.emplace_back(&SM4BulkEngine::workerLoop, this);
+	}
+}
+
+SM4BulkEngine::~SM4BulkEngine()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void SM4BulkEngine::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+			{
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void SM4BulkEngine::parallelFor(size_t n, const std::function<void(size_t)>& job)
+{
+	if (workers.empty() || n <= 1)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	std::vector<std::future<void>> pending;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		for (size_t i = 1; i < n; i++)
+		{
+			auto task = std::make_shared<std::packaged_task<void()>>([&job, i] { job(i); });
+			pending.push_back(task->get_future());
+			tasks.emplace_back([task] { (*task)(); });
+		}
+	}
+	cv.notify_all();
+	job(0);
+	for (auto& f : pending)
+	{
+		f.get();
+	}
+}
+
+void SM4BulkEngine::ecb(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks, const SM4Kernel& kernel)
+{
+	const size_t per_chunk = CHUNK_SIZE / 16;
+	parallelFor((nblocks + per_chunk - 1) / per_chunk, [&](size_t i) {
+		size_t first = i * per_chunk;
+		size_t n = nblocks - first < per_chunk ? nblocks - first : per_chunk;
+		kernel.blocks(rk, in + 16 * first, out + 16 * first, n);
+	});
+}
+
+void SM4BulkEngine::ctr(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len, const SM4Kernel& kernel)
+{
+	parallelFor((len + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](size_t i) {
+		size_t offset = i * CHUNK_SIZE;
+		size_t bytes = len - offset < CHUNK_SIZE ? len - offset : CHUNK_SIZE;
+		sm4_ctr_segment(kernel, rk, iv, offset / 16, in + offset, out + offset, bytes);
+	});
+}
+
+void SM4BulkEngine::cbcDecrypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks, const SM4Kernel& kernel)
+{
+	const size_t per_chunk = CHUNK_SIZE / 16;
+	size_t nchunks = (nblocks + per_chunk - 1) / per_chunk;
+
+	// 原地解密时前一块会覆盖本块的IV，先全部取出
+	std::vector<uint8_t> ivs(16 * nchunks);
+	if (nchunks > 0)
+	{
+		memcpy(ivs.data(), iv, 16);
+	}
+	for (size_t i = 1; i < nchunks; i++)
+	{
+		memcpy(ivs.data() + 16 * i, in + 16 * (i * per_chunk - 1), 16);
+	}
+
+	parallelFor(nchunks, [&](size_t i) {
+		size_t first = i * per_chunk;
+		size_t n = nblocks - first < per_chunk ? nblocks - first : per_chunk;
+		sm4_cbc_decrypt_segment(kernel, rk, ivs.data() + 16 * i, in + 16 * first, out + 16 * first, n);
+	});
+}
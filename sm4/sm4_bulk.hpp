@@ -0,0 +1,55 @@
+#pragma once
+#include "sm4_internal.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 大块数据的多线程SM4引擎
+// 数据按 CHUNK_SIZE 切分，各块写回自己在输出缓冲区中的位置，结果与串行计算逐字节一致。
+// 只支持块间无依赖的运算: ECB、CTR 和 CBC解密(CBC加密无法并行)。
+
+class SM4BulkEngine {
+public:
+	/// @brief 每个任务处理的字节数(16的倍数，小于 SM4_BULK_THRESHOLD，分块内部不会再次并行)
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+	/// @brief 进程内共享的引擎，线程数等于CPU核数
+	static SM4BulkEngine& instance();
+
+	/// @param nthreads 并行度(含调用线程)，为1时全部在调用线程中执行
+	explicit SM4BulkEngine(size_t nthreads);
+	~SM4BulkEngine();
+
+	SM4BulkEngine(const SM4BulkEngine&) = delete;
+	SM4BulkEngine& operator=(const SM4BulkEngine&) = delete;
+
+	size_t threads() const { return workers.size() + 1; }
+
+	// 以下运算的kernel默认为调用时的当前后端，各块都用这一个内核
+
+	/// @brief 并行ECB加解密
+	void ecb(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks, const SM4Kernel& kernel = sm4_kernel());
+
+	/// @brief 并行CTR加解密，各块的起始计数器由块号直接算出
+	void ctr(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len, const SM4Kernel& kernel = sm4_kernel());
+
+	/// @brief 并行CBC解密，各块的IV为前一块的最后一个密文分组，支持原地解密
+	void cbcDecrypt(const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks, const SM4Kernel& kernel = sm4_kernel());
+
+	/// @brief 执行 job(0) .. job(n-1)，调用线程执行第0块，返回时全部完成(SM3树哈希也用它分发叶子)
+	void parallelFor(size_t n, const std::function<void(size_t)>& job);
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool stopping;
+};
@@ -0,0 +1,317 @@
+#include "sm4_internal.hpp"
+#include "sm4.hpp"
+#include <cstring>
+#include <stdexcept>
+
+// SM4-GCM (GB/T 36624, RFC 8998)
+// 每64个分组为一段: 先生成这一段的CTR密钥流并异或，再对这一段密文做GHASH，
+// 数据在缓存中只过一遍。GHASH 优先使用 PCLMULQDQ，4个分组聚合后只做一次约减。
+
+static inline uint64_t load_be64(const uint8_t* p)
+{
+	uint64_t x = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		x = (x << 8) | p[i];
+	}
+	return x;
+}
+
+static inline void store_be64(uint8_t* p, uint64_t x)
+{
+	for (int i = 7; i >= 0; i--)
+	{
+		p[i] = uint8_t(x);
+		x >>= 8;
+	}
+}
+
+// GF(2^128) 乘法 X = X * H (GCM比特序)，逐位掩码实现，无分支
+static void gfmul_scalar(uint8_t X[16], const uint8_t H[16])
+{
+	uint64_t vh = load_be64(H), vl = load_be64(H + 8);
+	uint64_t xh = load_be64(X), xl = load_be64(X + 8);
+	uint64_t zh = 0, zl = 0;
+	for (int i = 0; i < 128; i++)
+	{
+		uint64_t bit = i < 64 ? (xh >> (63 - i)) & 1 : (xl >> (127 - i)) & 1;
+		uint64_t m = 0 - bit;
+		zh ^= vh & m;
+		zl ^= vl & m;
+		uint64_t r = 0 - (vl & 1);
+		vl = (vl >> 1) | (vh << 63);
+		vh = (vh >> 1) ^ (0xE100000000000000ULL & r);
+	}
+	store_be64(X, zh);
+	store_be64(X + 8, zl);
+}
+
+static void ghash_scalar(const uint8_t H[16], uint8_t X[16], const uint8_t* data, size_t nblocks)
+{
+	for (size_t i = 0; i < nblocks; i++)
+	{
+		for (int j = 0; j < 16; j++)
+		{
+			X[j] ^= data[16 * i + j];
+		}
+		gfmul_scalar(X, H);
+	}
+}
+
+typedef void (*ghash_fn)(const uint8_t H[16], uint8_t X[16], const uint8_t* data, size_t nblocks);
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SM4_PCLMUL __attribute__((target("ssse3,pclmul")))
+
+bool sm4_cpu_has_pclmul()
+{
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+// 寄存器内按字节反序存放，比特反射由约减前左移1位抵消(Intel CLMUL白皮书算法5)
+SM4_PCLMUL static inline __m128i bswap128(__m128i x)
+{
+	return _mm_shuffle_epi8(x, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// 256位无约减乘积累加到 (lo, hi)
+SM4_PCLMUL static inline void clmul_acc(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+{
+	__m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+	lo = _mm_xor_si128(lo, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x00), _mm_slli_si128(mid, 8)));
+	hi = _mm_xor_si128(hi, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x11), _mm_srli_si128(mid, 8)));
+}
+
+// 左移1位后模 x^128 + x^7 + x^2 + x + 1 约减
+SM4_PCLMUL static inline __m128i reduce(__m128i lo, __m128i hi)
+{
+	__m128i t7 = _mm_srli_epi32(lo, 31);
+	__m128i t8 = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+	__m128i t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	lo = _mm_or_si128(lo, t7);
+	hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+	t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+	t8 = _mm_srli_si128(t7, 4);
+	lo = _mm_xor_si128(lo, _mm_slli_si128(t7, 12));
+	__m128i t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+	lo = _mm_xor_si128(lo, _mm_xor_si128(t2, t8));
+	return _mm_xor_si128(hi, lo);
+}
+
+SM4_PCLMUL static inline __m128i gfmul(__m128i a, __m128i b)
+{
+	__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	clmul_acc(a, b, lo, hi);
+	return reduce(lo, hi);
+}
+
+// X' = (X + C1)*H^4 + C2*H^3 + C3*H^2 + C4*H
+SM4_PCLMUL static void ghash_pclmul(const uint8_t H[16], uint8_t X[16], const uint8_t* data, size_t nblocks)
+{
+	__m128i h1 = bswap128(_mm_loadu_si128((const __m128i*)H));
+	__m128i x = bswap128(_mm_loadu_si128((const __m128i*)X));
+	if (nblocks >= 4)
+	{
+		__m128i h2 = gfmul(h1, h1);
+		__m128i h3 = gfmul(h2, h1);
+		__m128i h4 = gfmul(h3, h1);
+		while (nblocks >= 4)
+		{
+			__m128i c1 = bswap128(_mm_loadu_si128((const __m128i*)data));
+			__m128i c2 = bswap128(_mm_loadu_si128((const __m128i*)(data + 16)));
+			__m128i c3 = bswap128(_mm_loadu_si128((const __m128i*)(data + 32)));
+			__m128i c4 = bswap128(_mm_loadu_si128((const __m128i*)(data + 48)));
+			__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+			clmul_acc(_mm_xor_si128(x, c1), h4, lo, hi);
+			clmul_acc(c2, h3, lo, hi);
+			clmul_acc(c3, h2, lo, hi);
+			clmul_acc(c4, h1, lo, hi);
+			x = reduce(lo, hi);
+			data += 64;
+			nblocks -= 4;
+		}
+	}
+	for (size_t i = 0; i < nblocks; i++)
+	{
+		x = gfmul(_mm_xor_si128(x, bswap128(_mm_loadu_si128((const __m128i*)(data + 16 * i)))), h1);
+	}
+	_mm_storeu_si128((__m128i*)X, bswap128(x));
+}
+
+static ghash_fn select_ghash()
+{
+	return sm4_cpu_has_pclmul() ? ghash_pclmul : ghash_scalar;
+}
+
+#else
+
+bool sm4_cpu_has_pclmul()
+{
+	return false;
+}
+
+static ghash_fn select_ghash()
+{
+	return ghash_scalar;
+}
+
+#endif
+
+static const ghash_fn ghash_fast = select_ghash();
+
+// 标量后端下GHASH同样不用SIMD指令
+static void ghash_blocks(const uint8_t H[16], uint8_t X[16], const uint8_t* data, size_t nblocks)
+{
+	(sm4_get_backend() == SM4_BACKEND_SCALAR ? ghash_scalar : ghash_fast)(H, X, data, nblocks);
+}
+
+struct GHash
+{
+	uint8_t H[16];
+	uint8_t X[16];
+};
+
+// 末尾不足16字节的部分补零
+static void ghash_update(GHash& g, const uint8_t* data, size_t len)
+{
+	size_t nblocks = len / 16;
+	ghash_blocks(g.H, g.X, data, nblocks);
+	if (len % 16 != 0)
+	{
+		uint8_t last[16] = {0};
+		memcpy(last, data + 16 * nblocks, len % 16);
+		ghash_blocks(g.H, g.X, last, 1);
+	}
+}
+
+static inline void inc32(uint8_t ctr[16])
+{
+	for (int i = 15; i >= 12 && ++ctr[i] == 0; i--)
+	{
+	}
+}
+
+// H = E(0)，J0由IV得到，EJ0 = E(J0)用于最后的标签，AAD先行吸收
+// 两个单块加密都走当前后端的内核；12字节IV时一次算出
+static void gcm_start(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t* iv, size_t iv_len,
+	const uint8_t* aad, size_t aad_len, GHash& g, uint8_t J0[16], uint8_t EJ0[16])
+{
+	uint8_t buf[32] = {0};
+	memset(g.X, 0, 16);
+	if (iv_len == SM4_GCM_IV_SIZE)
+	{
+		memcpy(J0, iv, 12);
+		J0[12] = J0[13] = J0[14] = 0;
+		J0[15] = 1;
+		memcpy(buf + 16, J0, 16);
+		kernel.blocks(rk, buf, buf, 2);
+		memcpy(g.H, buf, 16);
+		memcpy(EJ0, buf + 16, 16);
+	}
+	else
+	{
+		kernel.blocks(rk, buf, g.H, 1);
+		uint8_t lens[16] = {0};
+		store_be64(lens + 8, uint64_t(iv_len) * 8);
+		ghash_update(g, iv, iv_len);
+		ghash_blocks(g.H, g.X, lens, 1);
+		memcpy(J0, g.X, 16);
+		memset(g.X, 0, 16);
+		kernel.blocks(rk, J0, EJ0, 1);
+	}
+	ghash_update(g, aad, aad_len);
+}
+
+static void gcm_finish(GHash& g, const uint8_t EJ0[16], size_t aad_len, size_t len, uint8_t tag[16])
+{
+	uint8_t lens[16];
+	store_be64(lens, uint64_t(aad_len) * 8);
+	store_be64(lens + 8, uint64_t(len) * 8);
+	ghash_blocks(g.H, g.X, lens, 1);
+	for (int i = 0; i < 16; i++)
+	{
+		tag[i] = EJ0[i] ^ g.X[i];
+	}
+}
+
+// 一段(至多 kernel.chunk 个分组)的CTR运算，计数器只递增低32位
+static void gcm_ctr(const SM4Kernel& kernel, const uint32_t rk[32], uint8_t ctr[16], const uint8_t* in, uint8_t* out, size_t bytes)
+{
+	uint8_t ks[16 * SM4_MAX_CHUNK];
+	size_t n = (bytes + 15) / 16;
+	for (size_t i = 0; i < n; i++)
+	{
+		inc32(ctr);
+		memcpy(ks + 16 * i, ctr, 16);
+	}
+	kernel.blocks(rk, ks, ks, n);
+	for (size_t i = 0; i < bytes; i++)
+	{
+		out[i] = in[i] ^ ks[i];
+	}
+}
+
+void sm4_gcm_encrypt(const uint32_t rk[32], const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+	const uint8_t* in, uint8_t* out, size_t len, uint8_t tag[SM4_GCM_TAG_SIZE])
+{
+	if (iv_len == 0)
+	{
+		throw std::invalid_argument("GCM的IV不能为空");
+	}
+	const SM4Kernel& kernel = sm4_kernel();
+	const size_t chunk = 16 * kernel.chunk;
+	GHash g;
+	uint8_t J0[16], EJ0[16], ctr[16];
+	gcm_start(kernel, rk, iv, iv_len, aad, aad_len, g, J0, EJ0);
+	memcpy(ctr, J0, 16);
+	for (size_t off = 0; off < len; off += chunk)
+	{
+		size_t bytes = len - off < chunk ? len - off : chunk;
+		gcm_ctr(kernel, rk, ctr, in + off, out + off, bytes);
+		ghash_update(g, out + off, bytes);
+	}
+	gcm_finish(g, EJ0, aad_len, len, tag);
+}
+
+bool sm4_gcm_decrypt(const uint32_t rk[32], const uint8_t* iv, size_t iv_len, const uint8_t* aad, size_t aad_len,
+	const uint8_t* in, uint8_t* out, size_t len, const uint8_t tag[SM4_GCM_TAG_SIZE])
+{
+	if (iv_len == 0)
+	{
+		throw std::invalid_argument("GCM的IV不能为空");
+	}
+	const SM4Kernel& kernel = sm4_kernel();
+	const size_t chunk = 16 * kernel.chunk;
+	GHash g;
+	uint8_t J0[16], EJ0[16], ctr[16], expected[16];
+	gcm_start(kernel, rk, iv, iv_len, aad, aad_len, g, J0, EJ0);
+	memcpy(ctr, J0, 16);
+	for (size_t off = 0; off < len; off += chunk)
+	{
+		// 原地解密时必须先吸收密文
+		size_t bytes = len - off < chunk ? len - off : chunk;
+		ghash_update(g, in + off, bytes);
+		gcm_ctr(kernel, rk, ctr, in + off, out + off, bytes);
+	}
+	gcm_finish(g, EJ0, aad_len, len, expected);
+
+	// 常数时间比较，失败时不留下任何明文
+	uint8_t diff = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		diff |= expected[i] ^ tag[i];
+	}
+	if (diff != 0)
+	{
+		memset(out, 0, len);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "sm4.hpp"
+#include <cstdint>
+#include <cstddef>
+
+// SM4 多分组内核及SM3共用常量(仅供 sm4/ 内部使用)
+// 每个内核对 nblocks 个互相独立的分组做 ECB 运算，可处理任意分组数
+
+extern const uint8_t SM4_SBOX[256];
+
+typedef void (*sm4_blocks_fn)(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief 标量内核，逐块调用 sm4_crypt_block
+void sm4_blocks_scalar(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief AVX2内核，每次并行处理8个分组，S盒由字节混洗查表完成
+void sm4_blocks_avx2(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief AES-NI内核，S盒经仿射同构映射到AESENCLAST，8分组交错
+void sm4_blocks_aesni(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief GFNI内核，S盒由gf2p8affine/gf2p8affineinv完成，8分组交错
+void sm4_blocks_gfni(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief 位切片内核一批的最大分组数(AVX2为256，否则为128)，不足一批时补齐计算
+const size_t SM4_BITSLICE_BATCH = 256;
+
+/// @brief 位切片内核，仅用布尔运算(常数时间)
+void sm4_blocks_bitslice(const uint32_t rk[32], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief 多分组内核及CBC解密/CTR每次交给它的分组数(取内核批宽的整数倍，避免每次补齐尾部)
+struct SM4Kernel
+{
+	SM4Backend backend;
+	sm4_blocks_fn blocks;
+	size_t chunk;
+};
+
+/// @brief CBC解密/CTR分段缓冲区的最大分组数
+const size_t SM4_MAX_CHUNK = SM4_BITSLICE_BATCH;
+
+/// @brief 当前后端的内核。sm4_set_backend可能在其他线程中切换，
+/// 每次运算只取一次并传给各分段，同一次运算的所有分段使用同一个内核
+const SM4Kernel& sm4_kernel();
+
+/// @brief CBC解密一段数据(SM4BulkEngine按段调用)
+void sm4_cbc_decrypt_segment(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+/// @brief CTR模式处理一段数据，计数器从 iv + first_block 开始(SM4BulkEngine按段调用)
+void sm4_ctr_segment(const SM4Kernel& kernel, const uint32_t rk[32], const uint8_t iv[16], uint64_t first_block, const uint8_t* in, uint8_t* out, size_t len);
+
+/// @brief 当前CPU是否支持AVX2 (CPUID)
+bool sm4_cpu_has_avx2();
+
+/// @brief 当前CPU是否支持AES-NI和SSSE3 (CPUID)
+bool sm4_cpu_has_aesni();
+
+/// @brief 当前CPU是否支持GFNI和SSSE3 (CPUID)
+bool sm4_cpu_has_gfni();
+
+/// @brief 当前CPU是否支持PCLMULQDQ和SSSE3 (CPUID)，用于GCM的GHASH
+bool sm4_cpu_has_pclmul();
+
+// SM3 常量(sm3.cpp)，多缓冲实现共用
+
+extern const uint32_t SM3_IV[8];
+
+/// @brief SM3轮常量 Tj <<< j
+struct SM3RoundConstants
+{
+	uint32_t t[64];
+	SM3RoundConstants();
+};
+
+extern const SM3RoundConstants SM3_TJ;
@@ -0,0 +1,253 @@
+#include "sm34.h"
+#include "sm3.hpp"
+#include "sm3_tree.hpp"
+#include "sm4_bulk.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(const string& name, const string& got, const string& expected)
+{
+    if (got == expected) {
+        cout << "✓ " << name << endl;
+    } else {
+        cout << "✗ " << name << endl;
+        cout << "  期望: " << expected << endl;
+        cout << "  实际: " << got << endl;
+        failures++;
+    }
+}
+
+static string to_hex(const uint8_t* p, size_t len)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    string hex;
+    for (size_t i = 0; i < len; i++) {
+        hex += digits[p[i] >> 4];
+        hex += digits[p[i] & 0xF];
+    }
+    return hex;
+}
+
+static string hash_hex(const vector<uint8_t>& data)
+{
+    uint8_t digest[SM3_DIGEST_SIZE];
+    sm3_hash(data.data(), data.size(), digest);
+    return to_hex(digest, SM3_DIGEST_SIZE);
+}
+
+int main() {
+    cout << "=== SM3 正确性测试 ===" << endl;
+
+    // GB/T 32905 标准测试向量
+    const string abc = "66C7F0F462EEEDD9D1F2D46BDC10E4E24167C4875CF2F7A2297DA02B8F4BA8E0";
+    const string abcd16 = "DEBE9FF92275B8A138604889C18E5A4D6FDB70E5387E5765293DCBA39C0C5732";
+    const string empty = "1AB21D8355CFA17F8E61194831E81A8F22BEC8C728FEFB747ED035EB5082AA2B";
+    string s64;
+    for (int i = 0; i < 16; i++) {
+        s64 += "abcd";
+    }
+    check("sm3(\"abc\")", sm3("abc", 0), abc);
+    check("sm3(abcd x16)", sm3(s64, 0), abcd16);
+    check("sm3(\"\")", sm3("", 0), empty);
+    check("sm3 HEX输入", sm3("616263", 1), abc);
+    check("sm3 小写HEX输入", sm3("abcdef0123", 1), hash_hex({0xAB, 0xCD, 0xEF, 0x01, 0x23}));
+    check("sm3 大写HEX输入", sm3("ABCDEF0123", 1), hash_hex({0xAB, 0xCD, 0xEF, 0x01, 0x23}));
+
+    // 流式接口: 任意切分方式与一次性计算相同
+    vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = uint8_t(i * 7 + 3);
+    }
+    const string whole = hash_hex(data);
+    for (size_t step : {1, 3, 55, 56, 63, 64, 65, 200}) {
+        SM3Context ctx;
+        sm3_init(ctx);
+        for (size_t off = 0; off < data.size(); off += step) {
+            sm3_update(ctx, data.data() + off, min(step, data.size() - off));
+        }
+        uint8_t digest[SM3_DIGEST_SIZE];
+        sm3_final(ctx, digest);
+        check("流式计算(每次" + to_string(step) + "字节)", to_hex(digest, SM3_DIGEST_SIZE), whole);
+    }
+
+    // 填充边界: 55/56/64字节处需要一个或两个填充分组，与原字符串实现比较
+    for (size_t len : {55, 56, 63, 64, 119, 120}) {
+        string msg(len, 'a');
+        check("填充边界 " + to_string(len) + "字节", sm3(msg, 0), iteration(padding(msg, 0)));
+    }
+
+    // HMAC-SM3: 参考值由Python hmac模块(hashlib sm3)计算
+    auto hmac_hex = [](const vector<uint8_t>& key, const string& msg) {
+        HMACSM3Key k;
+        hmac_sm3_set_key(k, key.data(), key.size());
+        uint8_t mac[SM3_DIGEST_SIZE];
+        hmac_sm3(k, reinterpret_cast<const uint8_t*>(msg.data()), msg.size(), mac);
+        return to_hex(mac, SM3_DIGEST_SIZE);
+    };
+    vector<uint8_t> key100(100), key64(64);
+    for (size_t i = 0; i < key100.size(); i++) {
+        key100[i] = uint8_t(i);
+    }
+    key64.assign(key100.begin(), key100.begin() + 64);
+    string abc50;
+    for (int i = 0; i < 50; i++) {
+        abc50 += "abc";
+    }
+    check("HMAC 短密钥", hmac_hex({'k', 'e', 'y'}, "The quick brown fox jumps over the lazy dog"),
+          "BD4A34077888162B210645B8EBF74B9AF357303789357A27C7FC457244EBD398");
+    check("HMAC 空密钥空消息", hmac_hex({}, ""), "0D23F72BA15E9C189A879AEFC70996B06091DE6E64D31B7A84004356DD915261");
+    check("HMAC 长密钥(先做SM3)", hmac_hex(key100, abc50), "61D2DCC1A3871E5581B9F6206C022785F16D8AE0B818949D976685599D5B9243");
+    check("HMAC 64字节密钥", hmac_hex(key64, "x"), "AB867E46EA99A707109CBE85AF19C605FCB57101E186452D25A92CD823CFC760");
+    {
+        // 同一密钥重复使用，流式输入
+        HMACSM3Key k;
+        hmac_sm3_set_key(k, key100.data(), key100.size());
+        HMACSM3Context ctx;
+        uint8_t mac[SM3_DIGEST_SIZE];
+        for (int round = 0; round < 2; round++) {
+            hmac_sm3_init(ctx, k);
+            for (size_t off = 0; off < abc50.size(); off += 7) {
+                hmac_sm3_update(ctx, reinterpret_cast<const uint8_t*>(abc50.data()) + off, min<size_t>(7, abc50.size() - off));
+            }
+            hmac_sm3_final(ctx, mac);
+            check("HMAC 流式计算(第" + to_string(round + 1) + "次)", to_hex(mac, SM3_DIGEST_SIZE),
+                  "61D2DCC1A3871E5581B9F6206C022785F16D8AE0B818949D976685599D5B9243");
+        }
+    }
+
+    // KDF: 参考值为按GM/T 0003.4定义用Python hashlib sm3拼接计算
+    {
+        uint8_t out[100];
+        sm3_kdf(reinterpret_cast<const uint8_t*>("abc"), 3, out, 16);
+        check("KDF 16字节", to_hex(out, 16), "FE1EA80DAC6F100C33537BD24619EC7C");
+        const string kdf100 = "7256BE0931EE006A0C2ABF0F301FB3D16BE504ED417238DAE0BDB3FDFA90A934"
+                              "21191B6A9A887B460789F30E9BBEB322289ED0F5900DF20D3BB23CA40C6B844D"
+                              "2AA736A520A953E7FF9FC85481C32459DF2032E1F3F756D658D054DD28DFFA19"
+                              "C9B864A4";
+        sm3_kdf(key100.data(), key100.size(), out, 100);
+        check("KDF 100字节", to_hex(out, 100), kdf100);
+        // 分多次取出与一次取出相同
+        SM3KDF kdf;
+        sm3_kdf_init(kdf, key100.data(), key100.size());
+        size_t off = 0;
+        for (size_t n : {16, 16, 1, 31, 36}) {
+            sm3_kdf_next(kdf, out + off, n);
+            off += n;
+        }
+        check("KDF 流式取出", to_hex(out, 100), kdf100);
+    }
+
+    // 多缓冲: 长度各不相同的消息，逐个提交后flush，每个结果与单独计算相同
+    {
+        vector<vector<uint8_t>> msgs;
+        for (size_t i = 0; i < 37; i++) {
+            size_t len = (i * 53) % 300;
+            msgs.emplace_back(data.begin(), data.begin() + len);
+        }
+        vector<SM3Job> jobs(msgs.size());
+        SM3JobManager manager;
+        size_t done = 0, matched = 0;
+        auto finish = [&](SM3Job* job) {
+            if (job == nullptr) {
+                return false;
+            }
+            size_t i = reinterpret_cast<size_t>(job->user_data);
+            done++;
+            matched += to_hex(job->digest, SM3_DIGEST_SIZE) == hash_hex(msgs[i]);
+            return true;
+        };
+        for (size_t i = 0; i < msgs.size(); i++) {
+            jobs[i].data = msgs[i].data();
+            jobs[i].len = msgs[i].size();
+            jobs[i].user_data = reinterpret_cast<void*>(i);
+            finish(manager.submit(&jobs[i]));
+        }
+        while (finish(manager.flush())) {
+        }
+        check("多缓冲完成数", to_string(done), to_string(msgs.size()));
+        check("多缓冲结果", to_string(matched), to_string(msgs.size()));
+    }
+
+    // 树哈希: 参考值按sm3_tree.hpp中的定义用Python hashlib sm3计算；结果与线程数无关
+    {
+        vector<uint8_t> in(1000);
+        for (size_t i = 0; i < in.size(); i++) {
+            in[i] = uint8_t(i * 7);
+        }
+        uint8_t digest[SM3_DIGEST_SIZE];
+        const string tree1000 = "4044AA44385A884A9008D030F4BE5B340CF575082C22E52AF127E03C9E956817";
+        SM4BulkEngine serial(1), pool(4);
+        sm3_tree_hash(serial, in.data(), in.size(), digest, 64);
+        check("树哈希 单线程", to_hex(digest, SM3_DIGEST_SIZE), tree1000);
+        sm3_tree_hash(pool, in.data(), in.size(), digest, 64);
+        check("树哈希 4线程", to_hex(digest, SM3_DIGEST_SIZE), tree1000);
+        sm3_tree_hash(nullptr, 0, digest);
+        check("树哈希 空输入", to_hex(digest, SM3_DIGEST_SIZE), "5B96281EA3302466D692956DDF62E6A8E4B2973838D5ABB37551D4084490C5BC");
+        bool thrown = false;
+        try {
+            sm3_tree_hash(in.data(), in.size(), digest, 100);
+        } catch (const invalid_argument&) {
+            thrown = true;
+        }
+        check("树哈希 叶子大小非64倍数", thrown ? "抛出" : "未抛出", "抛出");
+    }
+
+    cout << endl << "=== SM3 性能测试 ===" << endl;
+    string text(4096, 'x');
+    auto start = chrono::high_resolution_clock::now();
+    string legacy = iteration(padding(text, 0));
+    auto end = chrono::high_resolution_clock::now();
+    cout << "字符串实现 4KB: " << chrono::duration_cast<chrono::microseconds>(end - start).count() << " us" << endl;
+    start = chrono::high_resolution_clock::now();
+    string native = sm3(text, 0);
+    end = chrono::high_resolution_clock::now();
+    cout << "原生实现 4KB: " << chrono::duration_cast<chrono::microseconds>(end - start).count() << " us" << endl;
+    check("两种实现结果一致", native, legacy);
+
+    vector<uint8_t> big(1 << 20);
+    uint8_t digest[SM3_DIGEST_SIZE];
+    start = chrono::high_resolution_clock::now();
+    sm3_hash(big.data(), big.size(), digest);
+    end = chrono::high_resolution_clock::now();
+    cout << "原生实现 1MB: " << chrono::duration_cast<chrono::microseconds>(end - start).count() << " us" << endl;
+
+    // 大量短消息: 多缓冲与逐条计算比较
+    const size_t count = 20000;
+    vector<SM3Job> jobs(count);
+    start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        sm3_hash(big.data() + 64 * (i % 1024), 64, jobs[i].digest);
+    }
+    end = chrono::high_resolution_clock::now();
+    cout << "逐条计算 " << count << " x 64B: " << chrono::duration_cast<chrono::microseconds>(end - start).count() << " us" << endl;
+    SM3JobManager manager;
+    start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].data = big.data() + 64 * (i % 1024);
+        jobs[i].len = 64;
+        manager.submit(&jobs[i]);
+    }
+    while (manager.flush() != nullptr) {
+    }
+    end = chrono::high_resolution_clock::now();
+    cout << "多缓冲 " << count << " x 64B: " << chrono::duration_cast<chrono::microseconds>(end - start).count() << " us" << endl;
+
+    // 大文件: 树哈希与普通SM3比较
+    vector<uint8_t> huge(64 * 1024 * 1024, 'x');
+    start = chrono::high_resolution_clock::now();
+    sm3_hash(huge.data(), huge.size(), digest);
+    end = chrono::high_resolution_clock::now();
+    cout << "普通SM3 64MB: " << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+    start = chrono::high_resolution_clock::now();
+    sm3_tree_hash(huge.data(), huge.size(), digest);
+    end = chrono::high_resolution_clock::now();
+    cout << "树哈希 64MB: " << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+
+    cout << endl << (failures == 0 ? "全部通过" : "存在失败用例") << endl;
+    return failures == 0 ? 0 : 1;
+}
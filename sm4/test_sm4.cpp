@@ -0,0 +1,436 @@
+#include "sm34.h"
+#include "sm4.hpp"
+#include "sm4_bulk.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(const string& name, const string& got, const string& expected)
+{
+    if (got == expected) {
+        cout << "✓ " << name << endl;
+    } else {
+        cout << "✗ " << name << endl;
+        cout << "  期望: " << expected << endl;
+        cout << "  实际: " << got << endl;
+        failures++;
+    }
+}
+
+int main() {
+    const string key = "0123456789ABCDEFFEDCBA9876543210";
+    const string iv = "FEDCBA98765432100123456789ABCDEF";
+    const string text = String2Hex("The quick brown fox jumps over the lazy dog. 0123456789!");
+
+    cout << "=== SM4 正确性测试 ===" << endl;
+
+    // GB/T 32907 标准测试向量
+    check("单分组加密", sm4_encode(key, key), "681EDF34D206965E86B3E94F536E4246");
+    check("单分组解密", sm4_decode("681EDF34D206965E86B3E94F536E4246", key), key);
+
+    // 以下密文由原HEX字符串实现生成，用于保证新实现输出逐位一致
+    check("CBC加密(短消息)", sm4_encode_CBC(String2Hex("hello"), key, iv), "7D440F460D870171C6CF966C9730A949");
+    check("CBC加密(整分组)", sm4_encode_CBC(String2Hex("0123456789abcdef"), key, iv),
+          "C1DF54E096F2CD6B7574436F9BEC50B37040B45D1F9FF88E07E3FDD9B683FEFD");
+    check("CBC加密(多分组)", sm4_encode_CBC(text, key, iv),
+          "289DB110150AF984935CDC485AF7075065C16DE7466162239EBAEDF5C777AAB1"
+          "5F7CB079E69CDB31C7E7079BAE46C1E39939342AE639373D635FFE2C4B640AB0");
+    check("ECB加密(多分组)", sm4_encode_ECB(text, key),
+          "088C41BEAC31615D33C94FACE62404A66ECF036539A35DDB288C6A82BFE937DB"
+          "0251682F258C7FDE4D08590924DA5AE14DD7AE4EA3F89BB334341EBD5FDD6745");
+    check("CBC往返", sm4_decode_CBC(sm4_encode_CBC(text, key, iv), key, iv), text);
+    check("ECB往返", sm4_decode_ECB(sm4_encode_ECB(text, key), key), text);
+
+    SM4Context ctx;
+    sm4_set_key_hex(ctx, key, iv);
+    check("CBC加密(密钥上下文)", sm4_encode_CBC(text, ctx), sm4_encode_CBC(text, key, iv));
+    check("CBC往返(密钥上下文)", sm4_decode_CBC(sm4_encode_CBC(text, ctx), ctx), text);
+
+    // 各后端与标量实现逐字节比较(覆盖不足8块的尾部)
+    uint8_t k[16], v[16];
+    for (int i = 0; i < 16; i++) {
+        k[i] = uint8_t(i * 17 + 3);
+        v[i] = uint8_t(i * 29 + 7);
+    }
+    uint32_t rk[32], rk_dec[32];
+    sm4_key_schedule(k, rk);
+    sm4_key_schedule_dec(k, rk_dec);
+
+    vector<uint8_t> plain(16 * 300);
+    for (size_t i = 0; i < plain.size(); i++) {
+        plain[i] = uint8_t(i * 131 + 11);
+    }
+    vector<uint8_t> ecb_ref(plain.size()), cbc_ref(plain.size());
+    sm4_set_backend(SM4_BACKEND_SCALAR);
+    sm4_ecb_crypt(rk, plain.data(), ecb_ref.data(), 300);
+    sm4_cbc_encrypt(rk, v, plain.data(), cbc_ref.data(), 300);
+
+    const SM4Backend backends[] = {SM4_BACKEND_SCALAR, SM4_BACKEND_AVX2, SM4_BACKEND_AESNI, SM4_BACKEND_GFNI, SM4_BACKEND_BITSLICE};
+    for (SM4Backend backend : backends) {
+        if (!sm4_set_backend(backend)) {
+            cout << "- " << sm4_backend_name(backend) << ": CPU不支持，跳过" << endl;
+            continue;
+        }
+        string name = sm4_backend_name(backend);
+        for (size_t n : {1, 3, 8, 13, 64, 77, 128, 129, 255, 256, 257, 300}) {
+            vector<uint8_t> out(16 * n);
+            sm4_ecb_crypt(rk, plain.data(), out.data(), n);
+            check(name + " ECB " + to_string(n) + "块", string(out.begin(), out.end()),
+                  string(ecb_ref.begin(), ecb_ref.begin() + 16 * n));
+
+            vector<uint8_t> enc(16 * n);
+            sm4_cbc_encrypt(rk, v, plain.data(), enc.data(), n);
+            check(name + " CBC加密 " + to_string(n) + "块", string(enc.begin(), enc.end()),
+                  string(cbc_ref.begin(), cbc_ref.begin() + 16 * n));
+
+            // 原地CBC解密
+            vector<uint8_t> buf(cbc_ref.begin(), cbc_ref.begin() + 16 * n);
+            sm4_cbc_decrypt(rk_dec, v, buf.data(), buf.data(), n);
+            check(name + " CBC解密 " + to_string(n) + "块", string(buf.begin(), buf.end()),
+                  string(plain.begin(), plain.begin() + 16 * n));
+        }
+        check(name + " CBC往返(HEX接口)", sm4_decode_CBC(sm4_encode_CBC(text, key, iv), key, iv), text);
+    }
+
+    // CTR: 与逐块加密计数器再异或的参考实现比较，iv末尾全FF用于覆盖进位
+    sm4_set_backend(SM4_BACKEND_SCALAR);
+    uint8_t ctr_iv[16];
+    for (int i = 0; i < 16; i++) {
+        ctr_iv[i] = i < 12 ? uint8_t(i + 1) : 0xFF;
+    }
+    auto ctr_ref = [&](const uint8_t* in, size_t len) {
+        vector<uint8_t> out(len);
+        uint8_t counter[16], ks[16];
+        memcpy(counter, ctr_iv, 16);
+        for (size_t off = 0; off < len; off += 16) {
+            sm4_crypt_block(rk, counter, ks);
+            for (size_t j = 0; j < 16 && off + j < len; j++) {
+                out[off + j] = in[off + j] ^ ks[j];
+            }
+            for (int j = 15; j >= 0 && ++counter[j] == 0; j--) {
+            }
+        }
+        return out;
+    };
+    vector<uint8_t> big(SM4_BULK_THRESHOLD + 16 * 1000 + 5);
+    for (size_t i = 0; i < big.size(); i++) {
+        big[i] = uint8_t(i * 7 + 1);
+    }
+    for (SM4Backend backend : backends) {
+        if (!sm4_set_backend(backend)) {
+            continue;
+        }
+        string name = sm4_backend_name(backend);
+        for (size_t len : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(100), size_t(16 * 77 + 9), big.size()}) {
+            vector<uint8_t> expected = ctr_ref(big.data(), len);
+            vector<uint8_t> out(big.begin(), big.begin() + len);
+            sm4_ctr_crypt(rk, ctr_iv, out.data(), out.data(), len);
+            check(name + " CTR " + to_string(len) + "字节", string(out.begin(), out.end()),
+                  string(expected.begin(), expected.end()));
+        }
+    }
+
+    // 位切片接口不受当前后端影响；大块数据经多线程引擎
+    sm4_set_backend(SM4_BACKEND_SCALAR);
+    {
+        size_t big_blocks = big.size() / 16;
+        vector<uint8_t> expected(16 * big_blocks), out(16 * big_blocks);
+        for (size_t i = 0; i < big_blocks; i++) {
+            sm4_crypt_block(rk, big.data() + 16 * i, expected.data() + 16 * i);
+        }
+        for (size_t n : {size_t(1), size_t(255), size_t(257), big_blocks}) {
+            sm4_ecb_crypt_bitsliced(rk, big.data(), out.data(), n);
+            check("位切片ECB " + to_string(n) + "块", string(out.begin(), out.begin() + 16 * n),
+                  string(expected.begin(), expected.begin() + 16 * n));
+        }
+        for (size_t len : {size_t(15), size_t(16 * 300 + 9), big.size()}) {
+            vector<uint8_t> ctr_expected = ctr_ref(big.data(), len);
+            vector<uint8_t> ctr_out(big.begin(), big.begin() + len);
+            sm4_ctr_crypt_bitsliced(rk, ctr_iv, ctr_out.data(), ctr_out.data(), len);
+            check("位切片CTR " + to_string(len) + "字节", string(ctr_out.begin(), ctr_out.end()),
+                  string(ctr_expected.begin(), ctr_expected.end()));
+        }
+    }
+
+    // GCM: RFC 8998 附录A.1 测试向量
+    auto from_hex = [](const string& hex) {
+        string bin = Hex2string(hex);
+        return vector<uint8_t>(bin.begin(), bin.end());
+    };
+    auto to_hex = [](const uint8_t* p, size_t len) {
+        static const char digits[] = "0123456789ABCDEF";
+        string hex;
+        for (size_t i = 0; i < len; i++) {
+            hex += digits[p[i] >> 4];
+            hex += digits[p[i] & 0xF];
+        }
+        return hex;
+    };
+    vector<uint8_t> gcm_key = from_hex("0123456789ABCDEFFEDCBA9876543210");
+    vector<uint8_t> gcm_iv = from_hex("00001234567800000000ABCD");
+    vector<uint8_t> gcm_aad = from_hex("FEEDFACEDEADBEEFFEEDFACEDEADBEEFABADDAD2");
+    vector<uint8_t> gcm_plain = from_hex("AAAAAAAAAAAAAAAABBBBBBBBBBBBBBBBCCCCCCCCCCCCCCCCDDDDDDDDDDDDDDDD"
+                                         "EEEEEEEEEEEEEEEEFFFFFFFFFFFFFFFFEEEEEEEEEEEEEEEEAAAAAAAAAAAAAAAA");
+    uint32_t gcm_rk[32];
+    sm4_key_schedule(gcm_key.data(), gcm_rk);
+    // 16字节IV: J0由GHASH得到，H与E(J0)分两次加密，各后端与标量结果一致
+    sm4_set_backend(SM4_BACKEND_SCALAR);
+    vector<uint8_t> long_iv_ref(gcm_plain.size());
+    uint8_t long_iv_tag[SM4_GCM_TAG_SIZE];
+    sm4_gcm_encrypt(gcm_rk, gcm_key.data(), 16, gcm_aad.data(), gcm_aad.size(),
+                    gcm_plain.data(), long_iv_ref.data(), long_iv_ref.size(), long_iv_tag);
+    for (SM4Backend backend : backends) {
+        if (!sm4_set_backend(backend)) {
+            continue;
+        }
+        string name = sm4_backend_name(backend);
+        vector<uint8_t> out(gcm_plain.size());
+        uint8_t tag[SM4_GCM_TAG_SIZE];
+        sm4_gcm_encrypt(gcm_rk, gcm_iv.data(), gcm_iv.size(), gcm_aad.data(), gcm_aad.size(),
+                        gcm_plain.data(), out.data(), out.size(), tag);
+        check(name + " GCM密文", to_hex(out.data(), out.size()),
+              "17F399F08C67D5EE19D0DC9969C4BB7D5FD46FD3756489069157B282BB200735"
+              "D82710CA5C22F0CCFA7CBF93D496AC15A56834CBCF98C397B4024A2691233B8D");
+        check(name + " GCM标签", to_hex(tag, 16), "83DE3541E4C2B58177E065A9BF7B62EC");
+        sm4_gcm_encrypt(gcm_rk, gcm_key.data(), 16, gcm_aad.data(), gcm_aad.size(),
+                        gcm_plain.data(), out.data(), out.size(), tag);
+        check(name + " GCM 16字节IV", to_hex(out.data(), out.size()) + to_hex(tag, 16),
+              to_hex(long_iv_ref.data(), long_iv_ref.size()) + to_hex(long_iv_tag, 16));
+
+        // 大数据(多段、非整分组)原地往返，篡改密文或标签必须失败
+        vector<uint8_t> data(big.begin(), big.begin() + 16 * 200 + 7);
+        sm4_gcm_encrypt(rk, v, 12, nullptr, 0, data.data(), data.data(), data.size(), tag);
+        bool ok = sm4_gcm_decrypt(rk, v, 12, nullptr, 0, data.data(), data.data(), data.size(), tag);
+        check(name + " GCM往返", ok && equal(data.begin(), data.end(), big.begin()) ? "通过" : "失败", "通过");
+        sm4_gcm_encrypt(rk, v, 12, nullptr, 0, data.data(), data.data(), data.size(), tag);
+        data[1234] ^= 1;
+        ok = sm4_gcm_decrypt(rk, v, 12, nullptr, 0, data.data(), data.data(), data.size(), tag);
+        check(name + " GCM篡改检测", !ok && data[0] == 0 ? "通过" : "失败", "通过");
+    }
+
+    // 空IV没有定义，加密和解密都拒绝
+    {
+        uint8_t tag[SM4_GCM_TAG_SIZE] = {0};
+        vector<uint8_t> out(gcm_plain.size());
+        int rejected = 0;
+        try {
+            sm4_gcm_encrypt(gcm_rk, gcm_iv.data(), 0, nullptr, 0, gcm_plain.data(), out.data(), out.size(), tag);
+        } catch (const invalid_argument&) {
+            rejected++;
+        }
+        try {
+            sm4_gcm_decrypt(gcm_rk, gcm_iv.data(), 0, nullptr, 0, gcm_plain.data(), out.data(), out.size(), tag);
+        } catch (const invalid_argument&) {
+            rejected++;
+        }
+        check("GCM空IV", to_string(rejected), "2");
+    }
+
+    // 多线程引擎: 显式指定4个线程，与串行结果逐字节比较
+    sm4_set_backend(SM4_BACKEND_SCALAR);
+    SM4BulkEngine engine(4);
+    const size_t bulk_blocks = 4 * SM4BulkEngine::CHUNK_SIZE / 16 + 37;
+    vector<uint8_t> bulk_plain(16 * bulk_blocks), bulk_ref(16 * bulk_blocks), bulk_out(16 * bulk_blocks);
+    for (size_t i = 0; i < bulk_plain.size(); i++) {
+        bulk_plain[i] = uint8_t(i * 13 + (i >> 8));
+    }
+    for (size_t i = 0; i < bulk_blocks; i++) {
+        sm4_crypt_block(rk, bulk_plain.data() + 16 * i, bulk_ref.data() + 16 * i);
+    }
+    engine.ecb(rk, bulk_plain.data(), bulk_out.data(), bulk_blocks);
+    check("多线程ECB", bulk_out == bulk_ref ? "一致" : "不一致", "一致");
+
+    vector<uint8_t> ctr_expected = ctr_ref(bulk_plain.data(), bulk_plain.size() - 5);
+    bulk_out.assign(bulk_plain.begin(), bulk_plain.end() - 5);
+    engine.ctr(rk, ctr_iv, bulk_out.data(), bulk_out.data(), bulk_out.size());
+    check("多线程CTR(原地)", bulk_out == ctr_expected ? "一致" : "不一致", "一致");
+
+    bulk_out.resize(bulk_plain.size());
+    sm4_cbc_encrypt(rk, v, bulk_plain.data(), bulk_out.data(), bulk_blocks);
+    engine.cbcDecrypt(rk_dec, v, bulk_out.data(), bulk_out.data(), bulk_blocks);
+    check("多线程CBC解密(原地)", bulk_out == bulk_plain ? "一致" : "不一致", "一致");
+
+    // 另一线程不停切换后端时，多线程ECB的结果不受影响
+    {
+        atomic<bool> done(false);
+        thread switcher([&] {
+            while (!done) {
+                for (SM4Backend backend : backends) {
+                    sm4_set_backend(backend);
+                }
+            }
+        });
+        bool same = true;
+        for (int round = 0; round < 4 && same; round++) {
+            engine.ecb(rk, bulk_plain.data(), bulk_out.data(), bulk_blocks);
+            same = bulk_out == bulk_ref;
+        }
+        done = true;
+        switcher.join();
+        sm4_set_backend(SM4_BACKEND_SCALAR);
+        check("切换后端时多线程ECB", same ? "一致" : "不一致", "一致");
+    }
+
+    // 批量CBC: 11条长度不同的消息(超过一批)，原地加密，与逐条串行结果比较
+    for (SM4Backend backend : backends) {
+        if (!sm4_set_backend(backend)) {
+            continue;
+        }
+        const size_t lens[] = {3, 1, 0, 8, 5, 17, 2, 9, 4, 1, 6};
+        const size_t count = sizeof(lens) / sizeof(lens[0]);
+        vector<vector<uint8_t>> msgs(count), refs(count);
+        const uint8_t* ivs[count];
+        const uint8_t* ins[count];
+        uint8_t* outs[count];
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            msgs[i].assign(plain.begin() + offset, plain.begin() + offset + 16 * lens[i]);
+            offset += 16 * lens[i];
+            refs[i].resize(msgs[i].size());
+            sm4_cbc_encrypt(rk, plain.data() + i, msgs[i].data(), refs[i].data(), lens[i]);
+            ivs[i] = plain.data() + i;
+            ins[i] = msgs[i].data();
+            outs[i] = msgs[i].data();
+        }
+        sm4_cbc_encrypt_multi(rk, ivs, ins, outs, lens, count);
+        check(string(sm4_backend_name(backend)) + " 批量CBC加密", msgs == refs ? "一致" : "不一致", "一致");
+    }
+
+    // PKCS7: 各长度原地填充后都能去除；篡改任一填充字节或填充值越界都判为无效
+    {
+        size_t ok = 0, total = 0;
+        for (size_t len = 0; len <= 40; len++) {
+            vector<uint8_t> buf(len / 16 * 16 + 16, 0xAA);
+            size_t padded = sm4_pkcs7_pad(buf.data(), len);
+            size_t plain_len = 0;
+            ok += padded == buf.size() && sm4_pkcs7_unpad(buf.data(), padded, plain_len) && plain_len == len;
+            total++;
+        }
+        check("PKCS7填充往返", to_string(ok), to_string(total));
+
+        size_t rejected = 0, cases = 0;
+        for (size_t pad = 1; pad <= 16; pad++) {
+            vector<uint8_t> buf(32, 0x55);
+            sm4_pkcs7_pad(buf.data(), 32 - pad);
+            for (size_t i = 32 - pad; i < 31; i++) {
+                vector<uint8_t> bad = buf;
+                bad[i] ^= 1;
+                size_t plain_len = 0;
+                rejected += !sm4_pkcs7_unpad(bad.data(), bad.size(), plain_len);
+                cases++;
+            }
+        }
+        for (uint8_t last : {uint8_t(0), uint8_t(17), uint8_t(0xFF)}) {
+            vector<uint8_t> bad(32, last);
+            size_t plain_len = 0;
+            rejected += !sm4_pkcs7_unpad(bad.data(), bad.size(), plain_len);
+            cases++;
+        }
+        check("PKCS7非法填充", to_string(rejected), to_string(cases));
+    }
+
+    // HEX编解码: 覆盖SIMD整块和尾部的各种长度，与逐字节查表结果比较
+    {
+        vector<uint8_t> bytes(300);
+        for (size_t i = 0; i < bytes.size(); i++) {
+            bytes[i] = uint8_t(i * 151 + 7);
+        }
+        size_t encoded = 0, decoded = 0, lengths = 0;
+        for (size_t len = 0; len <= bytes.size(); len += (len < 80 ? 1 : 37)) {
+            string hex(2 * len, '\0');
+            hex_encode(bytes.data(), len, &hex[0]);
+            encoded += hex == to_hex(bytes.data(), len);
+            string lower = hex;
+            transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            vector<uint8_t> back(len);
+            decoded += hex_decode(lower.data(), lower.size(), back.data()) && equal(back.begin(), back.end(), bytes.begin());
+            lengths++;
+        }
+        check("HEX编码", to_string(encoded), to_string(lengths));
+        check("HEX解码(小写)", to_string(decoded), to_string(lengths));
+
+        // 非法字符出现在不同位置(AVX2块、SSSE3块、标量尾部)都能检出
+        string hex = to_hex(bytes.data(), 100);
+        vector<uint8_t> out(100);
+        size_t rejected = 0, positions = 0;
+        for (size_t pos : {size_t(0), size_t(31), size_t(63), size_t(64), size_t(100), size_t(127), size_t(150), size_t(199)}) {
+            for (char bad : {'G', 'g', '/', ':', '@', '`', ' ', '\x80', '\xC6'}) {
+                string s = hex;
+                s[pos] = bad;
+                rejected += !hex_decode(s.data(), s.size(), out.data());
+                positions++;
+            }
+        }
+        check("HEX非法字符", to_string(rejected), to_string(positions));
+        check("HEX奇数长度", hex_decode(hex.data(), 199, out.data()) ? "接受" : "拒绝", "拒绝");
+
+        // 原地解码
+        string inplace = hex;
+        hex_decode(inplace.data(), inplace.size(), reinterpret_cast<uint8_t*>(&inplace[0]));
+        check("HEX原地解码", to_hex(reinterpret_cast<const uint8_t*>(inplace.data()), 100), hex);
+
+        check("String2Hex(高位字节)", String2Hex("\x80\xFF\x01"), "80FF01");
+        check("Hex2string(小写)", Hex2string("6869"), "hi");
+    }
+
+    // Base64: RFC 4648 第10节测试向量，及跨越AVX2整块的长输入(参考值由Python base64模块计算)
+    {
+        check("Base64 空", base64_encode(string("")), "");
+        check("Base64 f", base64_encode(string("f")), "Zg==");
+        check("Base64 fo", base64_encode(string("fo")), "Zm8=");
+        check("Base64 foo", base64_encode(string("foo")), "Zm9v");
+        check("Base64 foobar", base64_encode(string("foobar")), "Zm9vYmFy");
+        check("Base64解码 fo", base64_decode(string("Zm8=")), "fo");
+        string bytes(100, '\0');
+        for (size_t i = 0; i < bytes.size(); i++) {
+            bytes[i] = char(i * 151 + 7);
+        }
+        const string b64 = "B541zGP6kSi/Vu2EG7JJ4HcOpTzTagGYL8Zd9IsiuVDnfhWsQ9pxCJ82zWT7kinAV+6FHLNK4XgPpj3UawKZMMde9YwjulHofxatRNtyCaA3zmX8kyrBWO+GHbRL4nkQpz7VbA==";
+        check("Base64 100字节", base64_encode(bytes), b64);
+        check("Base64解码 100字节", base64_decode(b64) == bytes ? "一致" : "不一致", "一致");
+
+        size_t rejected = 0, cases = 0;
+        for (string bad : {string("Zm9"), string("Zm=v"), string("=m9v"), string("Zm9v\n"), b64.substr(0, 10) + "*" + b64.substr(11),
+                           b64.substr(0, 40) + "-" + b64.substr(41), b64.substr(0, 100) + "\x80" + b64.substr(101)}) {
+            try {
+                base64_decode(bad);
+            } catch (const invalid_argument&) {
+                rejected++;
+            }
+            cases++;
+        }
+        check("Base64非法输入", to_string(rejected), to_string(cases));
+    }
+
+    cout << endl << "=== SM4 性能测试 ===" << endl;
+    vector<uint8_t> buf(1 << 20);
+    for (SM4Backend backend : backends) {
+        if (!sm4_set_backend(backend)) {
+            continue;
+        }
+        auto start = chrono::high_resolution_clock::now();
+        sm4_ecb_crypt(rk, buf.data(), buf.data(), buf.size() / 16);
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+        cout << sm4_backend_name(backend) << " ECB 1MB: " << duration.count() << " us" << endl;
+    }
+    {
+        auto start = chrono::high_resolution_clock::now();
+        sm4_ecb_crypt_bitsliced(rk, buf.data(), buf.data(), buf.size() / 16);
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+        cout << "位切片接口(多线程) ECB 1MB: " << duration.count() << " us" << endl;
+    }
+
+    cout << endl << (failures == 0 ? "全部通过" : "存在失败用例") << endl;
+    return failures == 0 ? 0 : 1;
+}